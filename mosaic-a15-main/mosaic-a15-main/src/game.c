@@ -4,8 +4,10 @@
 
 #include <sys/types.h>
 
+#include "game_bitboard.h"
 #include "game_ext.h"
 #include "game_struct.h"
+#include "game_sums.h"
 #include "stdbool.h"
 #include "stdio.h"
 #include "stdlib.h"
@@ -13,53 +15,27 @@
 #endif  // __GAME_H__
 
 game game_new(constraint *constraints, color *colors) {
-  game g = game_new_empty();
-  for (int i = 0; i < g->height * g->width; i++) {
-    g->constraints[i] = constraints[i];
-    if (colors != NULL) {
-      g->colors[i] = colors[i];
-    } else {
-      g->colors[i] = EMPTY;
-    }
-  }
-  return g;
+  return game_new_ext(DEFAULT_SIZE, DEFAULT_SIZE, constraints, colors, false,
+                      FULL);
 }
 
 game game_new_empty(void) {
-  game g = malloc(sizeof(struct game_s));
-  if (g == NULL) {
-    fprintf(stderr, "Memory allocation failed");
-    exit(EXIT_FAILURE);
-  }
-  uint size = DEFAULT_SIZE;
-  g->height = size;
-  g->width = size;
-  g->constraints = malloc(size * size * sizeof(constraint));
-  g->colors = malloc(size * size * sizeof(color));
-  if (g->constraints == NULL || g->colors == NULL) {
-    fprintf(stderr, "Memory allocation failed");
-    game_delete(g);
-    exit(EXIT_FAILURE);
-  }
-  for (int i = 0; i < size * size; i++) {
-    g->constraints[i] = UNCONSTRAINED;
-    g->colors[i] = EMPTY;
-  }
-  g->neighbourhood = FULL;
-  g->wrapping = false;
-  g->prv_moves = queue_new();
-  g->undone_moves = queue_new();
-
-  return g;
+  return game_new_empty_ext(DEFAULT_SIZE, DEFAULT_SIZE, false, FULL);
 }
 
 game game_copy(cgame g) {
   game g2 =
       game_new_empty_ext(g->height, g->width, g->wrapping, g->neighbourhood);
-  for (int i = 0; i < g->height * g->width; i++) {
-    g2->constraints[i] = g->constraints[i];
-    g2->colors[i] = g->colors[i];
+  for (size_t i = 0; i < (size_t)g->height * g->width; i++) {
+    g2->cells[i] = g->cells[i];
+    g2->windows[i] = g->windows[i];
+  }
+  for (size_t i = 0; i < (size_t)g->height * g->words; i++) {
+    g2->black[i] = g->black[i];
+    g2->decided[i] = g->decided[i];
   }
+  g2->nb_empty = g->nb_empty;
+  g2->nb_unsatisfied = g->nb_unsatisfied;
 
   return g2;
 }
@@ -82,149 +58,185 @@ bool game_equal(cgame g1, cgame g2) {
 }
 
 void game_delete(game g) {
-  free(g->colors);
-  free(g->constraints);
+  free(g->cells);
+  free(g->black);
+  free(g->decided);
+  free(g->neighbours_start);
+  free(g->neighbours);
+  free(g->windows);
   queue_free_full(g->prv_moves, free);
   queue_free_full(g->undone_moves, free);
   free(g);
 }
 
+/* Status of the square of row-major index k, from the counts of its
+neighbourhood. */
+static status window_status(cgame g, size_t k) {
+  int nb_black = g->windows[k] & 15;
+  int nb_empty = g->windows[k] >> 4;
+  constraint n = cell_constraint(g, k);
+  // Special case: the square has no constraints:
+  if (n == UNCONSTRAINED) {
+    return nb_empty == 0 ? SATISFIED : UNSATISFIED;
+  }
+  // ERROR CASE: either there is more black squares than the constraint, or
+  // there is too much white squares in order for the condition to be met.
+  if (nb_black > n || nb_empty < n - nb_black) {
+    return ERROR;
+  }
+  // SATISFIED CASE:
+  else if (nb_black == n && nb_empty == 0) {
+    return SATISFIED;
+  } else {
+    return UNSATISFIED;
+  }
+}
+
+/* Same as window_status(g, k) == SATISFIED. */
+static bool window_satisfied(cgame g, size_t k) {
+  constraint n = cell_constraint(g, k);
+  return (g->windows[k] >> 4) == 0 &&
+         (n == UNCONSTRAINED || (g->windows[k] & 15) == n);
+}
+
+/* Adds delta_black and delta_empty to the counts of the neighbourhood of
+square k, and keeps the number of squares that are not satisfied. */
+static void window_update(game g, size_t k, int delta_black,
+                          int delta_empty) {
+  bool was_satisfied = window_satisfied(g, k);
+  // The counts never leave 0..9: no carry from one to the other.
+  g->windows[k] += delta_black + 16 * delta_empty;
+  bool satisfied = window_satisfied(g, k);
+  g->nb_unsatisfied += (int)was_satisfied - (int)satisfied;
+}
+
 void game_set_constraint(game g, uint i, uint j, constraint n) {
   // modified the constraints table using the row-major order to access to the
   // case.
-  g->constraints[(g->width * i) + j] = n;
+  size_t k = (size_t)g->width * i + j;
+  bool was_satisfied = window_satisfied(g, k);
+  cell_set_constraint(g, k, n);
+  bool satisfied = window_satisfied(g, k);
+  g->nb_unsatisfied += (int)was_satisfied - (int)satisfied;
 }
 
 void game_set_color(game g, uint i, uint j, color c) {
   // modified the colors table using the row-major order to access to the case.
-  g->colors[(g->width * i) + j] = c;
+  size_t k = (size_t)g->width * i + j;
+  color prev = cell_color(g, k);
+  cell_set_color(g, k, c);
+  bb_set_color(g, i, j, c);
+  if (prev == c) return;
+  // The neighbourhoods holding (i,j) are those of its neighbours, as every
+  // neighbourhood is symmetric, and as many times.
+  int delta_black = (c == BLACK) - (prev == BLACK);
+  int delta_empty = (c == EMPTY) - (prev == EMPTY);
+  g->nb_empty += delta_empty;
+  uint squares[9];
+  int n = g->ops->neighbours(g, i, j, squares);
+  for (int l = 0; l < n; l++)
+    window_update(g, squares[l], delta_black, delta_empty);
+}
+
+/* Bits 0 of the 8 bytes of x, gathered in the 8 bits of a byte. */
+static inline uint64_t gather8(uint64_t x) {
+  return (x * 0x0102040810204080ull) >> 56;
+}
+
+void game_sync(game g) {
+  // The counts are kept in locals: the stores to the rows could alias them.
+  uint width = g->width;
+  size_t nb_empty = 0;
+  for (size_t i = 0; i < (size_t)g->height * g->words; i++) {
+    g->black[i] = 0;
+    g->decided[i] = 0;
+  }
+  for (uint i = 0; i < g->height; i++) {
+    const uint8_t *cells = g->cells + (size_t)width * i;
+    uint64_t *black = bb_row(g->black, g, i);
+    uint64_t *decided = bb_row(g->decided, g, i);
+    // 8 squares at a time: their cells are read as one word, where the color
+    // of a square is in bits 0 and 1 of its byte.
+    uint j = 0;
+    for (; j + 8 <= width; j += 8) {
+      uint64_t x = 0;
+      for (uint b = 0; b < 8; b++) x |= (uint64_t)cells[j + b] << (8 * b);
+      const uint64_t ones = 0x0101010101010101ull;
+      uint64_t black8 = gather8((x >> 1) & ~x & ones);
+      uint64_t decided8 = gather8((x | x >> 1) & ones);
+      uint b = j + 1;  // never a multiple of 64: at most 1 bit spills over
+      black[b >> 6] |= black8 << (b & 63);
+      decided[b >> 6] |= decided8 << (b & 63);
+      if ((b & 63) > 56) {
+        black[(b >> 6) + 1] |= black8 >> (64 - (b & 63));
+        decided[(b >> 6) + 1] |= decided8 >> (64 - (b & 63));
+      }
+    }
+    for (; j < width; j++) {
+      color c = cells[j] & 3;
+      uint b = j + 1;
+      black[b >> 6] |= (uint64_t)(c == BLACK) << (b & 63);
+      decided[b >> 6] |= (uint64_t)(c != EMPTY) << (b & 63);
+    }
+    nb_empty += width;
+    for (uint w = 0; w < g->words; w++)
+      nb_empty -= __builtin_popcountll(decided[w]);
+    // The padding columns.
+    if (g->wrapping) {
+      bb_set_color(g, i, 0, cells[0] & 3);
+      bb_set_color(g, i, g->width - 1, cells[g->width - 1] & 3);
+    }
+  }
+  // The counts of a whole row of neighbourhoods at a time.
+  window_sums sums;
+  window_sums_init(&sums, g);
+  uint8_t *black = malloc(2 * g->width);
+  if (black == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  uint8_t *empty = black + g->width;
+  size_t nb_unsatisfied = 0;
+  for (uint i = 0; i < g->height; i++) {
+    window_sums_row(&sums, i, black, empty);
+    const uint8_t *cells = g->cells + (size_t)width * i;
+    uint8_t *windows = g->windows + (size_t)width * i;
+    for (uint j = 0; j < width; j++) {
+      windows[j] = black[j] | empty[j] << 4;
+      // Same as !window_satisfied, on the counts of the row, with no branch.
+      uint n = cells[j] >> 2;  // the constraint plus one
+      nb_unsatisfied += (empty[j] != 0) | ((n != 0) & (black[j] + 1u != n));
+    }
+  }
+  g->nb_empty = nb_empty;
+  g->nb_unsatisfied = nb_unsatisfied;
+  free(black);
+  window_sums_free(&sums);
 }
 
 constraint game_get_constraint(cgame g, uint i, uint j) {
-  return (g->constraints[(g->width * i) + j]);
+  return cell_constraint(g, (size_t)g->width * i + j);
 }
 
 color game_get_color(cgame g, uint i, uint j) {
-  return (g->colors[(g->width * i) + j]);
+  return cell_color(g, (size_t)g->width * i + j);
 }
 
 bool game_get_next_square(cgame g, uint i, uint j, direction dir, uint *pi_next,
                           uint *pj_next) {
-  // first we'll work on the y coordinates:
-  if (dir == UP || dir == UP_LEFT || dir == UP_RIGHT) {
-    *pi_next = i - 1;
-    if (g->wrapping && i == 0) {
-      *pi_next = g->height - 1;
-    }
-  } else if (dir == DOWN_LEFT || dir == DOWN_RIGHT || dir == DOWN) {
-    *pi_next = i + 1;
-    if (g->wrapping && i == g->height - 1) {
-      *pi_next = 0;
-    }
-  } else {
-    *pi_next = i;
-  }
-  // on the x:
-  if (dir == LEFT || dir == UP_LEFT || dir == DOWN_LEFT) {
-    *pj_next = j - 1;
-    if (g->wrapping && j == 0) {
-      *pj_next = g->width - 1;
-    }
-  } else if (dir == DOWN_RIGHT || dir == RIGHT || dir == UP_RIGHT) {
-    *pj_next = j + 1;
-    if (g->wrapping && j == g->width - 1) {
-      *pj_next = 0;
-    }
-  } else {
-    *pj_next = j;
-  }
-  // checking if the net_pos is in the correct field:
-  if (*pi_next >= g->height || *pi_next < 0 || *pj_next >= g->width ||
-      *pj_next < 0) {
-    return false;
-  }
-  return true;
+  return g->ops->next_square(g, i, j, dir, pi_next, pj_next);
 }
 
 status game_get_status(cgame g, uint i, uint j) {
-  // Special case: the square has no constraints:
-  if (game_get_constraint(g, i, j) == UNCONSTRAINED) {
-    if (game_nb_neighbors(g, i, j, EMPTY) == 0) {
-      return SATISFIED;
-    }
-    return UNSATISFIED;
-  }
-  // ERROR CASE:
-  if ((game_nb_neighbors(g, i, j, BLACK) >
-       game_get_constraint(
-           g, i,
-           j)) ||  // either there is more black squares than the constraint.
-      (game_nb_neighbors(g, i, j, EMPTY) <
-       game_get_constraint(g, i, j) -
-           game_nb_neighbors(
-               g, i, j, BLACK))) {  // or there is too much white squares in
-                                    // order for the condition to be met.
-    return ERROR;
-  }
-  // SATISFIED CASE:
-  else if ((game_nb_neighbors(g, i, j, BLACK) ==
-            game_get_constraint(g, i, j)) &&
-           (game_nb_neighbors(g, i, j, EMPTY) == 0)) {
-    return SATISFIED;
-  } else {
-    return UNSATISFIED;
-  }
+  return window_status(g, (size_t)g->width * i + j);
 }
 
 int game_nb_neighbors(cgame g, uint i, uint j, color c) {
-  // actually need to deal with the four neihbours possibilities
-  int count = 0;
-  uint i2;
-  uint j2;
-  if (g->neighbourhood == FULL) {
-    direction directions_FULL[] = {
-        UP_LEFT, UP, UP_RIGHT, LEFT, HERE, RIGHT, DOWN_LEFT, DOWN, DOWN_RIGHT};
-    for (int k = 0; k < 9; k++) {
-      if (game_get_next_square(g, i, j, directions_FULL[k], &i2, &j2) &&
-          game_get_color(g, i2, j2) == c) {
-        count++;
-      }
-    }
-  } else if (g->neighbourhood == ORTHO) {
-    direction directions_ORTHO[] = {
-        UP, LEFT, HERE, RIGHT, DOWN,
-    };
-    for (int k = 0; k < 5; k++) {
-      if (game_get_next_square(g, i, j, directions_ORTHO[k], &i2, &j2) &&
-          game_get_color(g, i2, j2) == c) {
-        count++;
-      }
-    }
-  } else if (g->neighbourhood == ORTHO_EXCLUDE) {
-    direction directions_ORTHO_EXCLUDE[] = {
-        UP,
-        LEFT,
-        RIGHT,
-        DOWN,
-    };
-    for (int k = 0; k < 4; k++) {
-      if (game_get_next_square(g, i, j, directions_ORTHO_EXCLUDE[k], &i2,
-                               &j2) &&
-          game_get_color(g, i2, j2) == c) {
-        count++;
-      }
-    }
-  } else {
-    direction directions_FULL_EXCLUDE[] = {
-        UP_LEFT, UP, UP_RIGHT, LEFT, RIGHT, DOWN_LEFT, DOWN, DOWN_RIGHT};
-    for (int k = 0; k < 8; k++) {
-      if (game_get_next_square(g, i, j, directions_FULL_EXCLUDE[k], &i2, &j2) &&
-          game_get_color(g, i2, j2) == c) {
-        count++;
-      }
-    }
-  }
-  return count;
+  int nb_squares, nb_black, nb_decided;
+  bb_window(g, i, j, &nb_squares, &nb_black, &nb_decided);
+  if (c == BLACK) return nb_black;
+  if (c == EMPTY) return nb_squares - nb_decided;
+  return nb_decided - nb_black;
 }
 
 void game_play_move(game g, uint i, uint j, color c) {
@@ -238,23 +250,16 @@ void game_play_move(game g, uint i, uint j, color c) {
   *(tab + 2) = prev_color;
   queue_push_head(g->prv_moves, tab);
   game_set_color(g, i, j, c);
-  queue_clear(g->undone_moves);
+  queue_clear_full(g->undone_moves, free);
 }
 
 bool game_won(cgame g) {
-  for (uint i = 0; i < g->height; i++) {
-    for (uint j = 0; j < g->width; j++) {
-      if (game_get_status(g, i, j) != SATISFIED) {
-        return false;
-      }
-    }
-  }
-  return true;
+  return g->nb_empty == 0 && g->nb_unsatisfied == 0;
 }
 
 void game_restart(game g) {
-  for (uint i = 0; i < DEFAULT_SIZE; i++) {
-    for (uint j = 0; j < DEFAULT_SIZE; j++) {
+  for (uint i = 0; i < g->height; i++) {
+    for (uint j = 0; j < g->width; j++) {
       game_set_color(g, i, j, EMPTY);
     }
   }
@@ -0,0 +1,134 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_ext.h"
+#include "game_file.h"
+#include "game_struct.h"
+#include "game_tools.h"
+
+#define MOSB_VERSION 1
+#define MOSB_HEADER_SIZE 16
+// Largest constraint saved, as 15 in 4 bits.
+#define MOSB_MAX_CONSTRAINT 14
+
+static uint32_t read_u32(const uint8_t* p) {
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static void write_u32(uint8_t* p, uint32_t v) {
+  for (int b = 0; b < 4; b++) p[b] = v >> (8 * b);
+}
+
+/* Size of the file of a game of nb_squares squares. */
+static size_t mosb_size(size_t nb_squares) {
+  return MOSB_HEADER_SIZE + (nb_squares + 1) / 2 + (nb_squares + 3) / 4;
+}
+
+/* Checks the header of the size bytes of data. Returns NULL if it is valid, or
+what is wrong. */
+static const char* mosb_check(const uint8_t* data, size_t size) {
+  if (data == NULL || size < MOSB_HEADER_SIZE || memcmp(data, "MOSB", 4) != 0)
+    return "not a binary game file";
+  if (data[4] != MOSB_VERSION) return "unknown version";
+  if (data[5] > 1 || data[6] > ORTHO_EXCLUDE || data[7] != 0)
+    return "invalid header";
+  uint32_t nb_rows = read_u32(data + 8), nb_cols = read_u32(data + 12);
+  if (nb_rows == 0 || nb_cols == 0) return "empty grid";
+  if (size != mosb_size((size_t)nb_rows * nb_cols)) return "truncated file";
+  return NULL;
+}
+
+/* Creates the game stored in data, checked by mosb_check. Returns NULL if a
+color is invalid. */
+static game mosb_decode(const uint8_t* data) {
+  uint32_t nb_rows = read_u32(data + 8), nb_cols = read_u32(data + 12);
+  game g = game_new_empty_ext(nb_rows, nb_cols, data[5], data[6]);
+  size_t nb_squares = (size_t)nb_rows * nb_cols;
+  const uint8_t* constraints = data + MOSB_HEADER_SIZE;
+  const uint8_t* colors = constraints + (nb_squares + 1) / 2;
+  // A cell holds the constraint plus one above the color: the 4 bits of the
+  // file are moved as they are.
+  uint8_t* cells = g->cells;
+  bool valid = true;
+  for (size_t k = 0; k < nb_squares; k++) {
+    uint8_t c = (colors[k / 4] >> (2 * (k % 4))) & 3;
+    valid &= c <= BLACK;
+    cells[k] = ((constraints[k / 2] >> (4 * (k % 2))) & 15) << 2 | c;
+  }
+  if (!valid) {
+    game_delete(g);
+    return NULL;
+  }
+  game_sync(g);
+  return g;
+}
+
+/* Decodes the size bytes of data, read from filename or NULL. */
+static game mosb_load(const char* filename, const uint8_t* data, size_t size) {
+  game g = NULL;
+  const char* error = mosb_check(data, size);
+  if (error == NULL) {
+    g = mosb_decode(data);
+    if (g == NULL) error = "invalid color";
+  }
+  if (error != NULL) {
+    if (filename != NULL) fprintf(stderr, "%s: ", filename);
+    fprintf(stderr, "%s\n", error);
+  }
+  return g;
+}
+
+game game_load_binary_from_buffer(const char* buffer, size_t size) {
+  return mosb_load(NULL, (const uint8_t*)buffer, size);
+}
+
+game game_load_binary(char* filename) {
+  mapped_file f;
+  if (!file_map(filename, &f, true)) return NULL;
+  game g = mosb_load(filename, (const uint8_t*)f.data, f.size);
+  file_unmap(&f);
+  return g;
+}
+
+size_t game_save_binary_to_buffer(cgame g, char* buffer, size_t size) {
+  size_t nb_squares = (size_t)g->height * g->width;
+  size_t file_size = mosb_size(nb_squares);
+  if (buffer == NULL || size < file_size) return file_size;
+  uint8_t* data = (uint8_t*)buffer;
+  uint8_t header[MOSB_HEADER_SIZE] = {'M', 'O', 'S', 'B', MOSB_VERSION,
+                                      g->wrapping, g->neighbourhood, 0};
+  write_u32(header + 8, g->height);
+  write_u32(header + 12, g->width);
+  memcpy(data, header, MOSB_HEADER_SIZE);
+  uint8_t* constraints = data + MOSB_HEADER_SIZE;
+  uint8_t* colors = constraints + (nb_squares + 1) / 2;
+  memset(constraints, 0, file_size - MOSB_HEADER_SIZE);
+  for (size_t k = 0; k < nb_squares; k++) {
+    constraint n = cell_constraint(g, k);
+    if (n > MOSB_MAX_CONSTRAINT) n = MOSB_MAX_CONSTRAINT;
+    constraints[k / 2] |= (n + 1) << (4 * (k % 2));
+    colors[k / 4] |= cell_color(g, k) << (2 * (k % 4));
+  }
+  return file_size;
+}
+
+void game_save_binary(cgame g, char* filename) {
+  size_t size = game_save_binary_to_buffer(g, NULL, 0);
+  char* buffer = malloc(size);
+  if (buffer == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  game_save_binary_to_buffer(g, buffer, size);
+  FILE* f = fopen(filename, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  fwrite(buffer, 1, size, f);
+  fclose(f);
+  free(buffer);
+}
@@ -0,0 +1,181 @@
+/**
+ * @file game_bitboard.h
+ * @brief Bit planes of the game colors (internal).
+ * @details Each row of the grid is stored in @ref game_s::words 64-bit words,
+ * one bit per square. The black plane has a bit set for each BLACK square and
+ * the decided plane for each square that is not EMPTY. Square (i,j) is bit j+1
+ * of row i: bits 0 and width+1 are padding columns, left to 0, or holding a
+ * copy of the opposite edge when the game is wrapping. A 3x3 window is then
+ * read with three shifts, whatever the position of the square.
+ **/
+
+#ifndef __GAME_BITBOARD_H__
+#define __GAME_BITBOARD_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "game_kernels.h"
+#include "game_struct.h"
+
+/** Number of 64-bit words needed to store a row of @p nb_cols squares and its
+ * two padding columns. */
+#define BB_WORDS(nb_cols) (((nb_cols) + 2 + 63) / 64)
+
+/* Squares of the upper, middle and lower rows of a window, as read by
+bb_get3: bit 0 is the left column, bit 1 the middle one and bit 2 the right
+one. */
+static const uint bb_masks[4][3] = {[FULL] = {7, 7, 7},
+                                    [ORTHO] = {2, 7, 2},
+                                    [FULL_EXCLUDE] = {7, 5, 7},
+                                    [ORTHO_EXCLUDE] = {2, 5, 2}};
+
+/* Number of bits set in a 3-bit value. */
+static const uint8_t bb_count3[8] = {0, 1, 1, 2, 1, 2, 2, 3};
+
+static inline uint64_t* bb_row(uint64_t* plane, cgame g, uint i) {
+  return plane + (size_t)i * g->words;
+}
+
+static inline void bb_set_bit(uint64_t* row, uint b, bool value) {
+  uint64_t bit = (uint64_t)1 << (b & 63);
+  if (value)
+    row[b >> 6] |= bit;
+  else
+    row[b >> 6] &= ~bit;
+}
+
+static inline void bb_set_color(game g, uint i, uint j, color c) {
+  uint64_t* black = bb_row(g->black, g, i);
+  uint64_t* decided = bb_row(g->decided, g, i);
+  bb_set_bit(black, j + 1, c == BLACK);
+  bb_set_bit(decided, j + 1, c != EMPTY);
+  if (g->wrapping && j == 0) {
+    bb_set_bit(black, g->width + 1, c == BLACK);
+    bb_set_bit(decided, g->width + 1, c != EMPTY);
+  }
+  if (g->wrapping && j == g->width - 1) {
+    bb_set_bit(black, 0, c == BLACK);
+    bb_set_bit(decided, 0, c != EMPTY);
+  }
+}
+
+/* Colors the square of row-major index k, in its cell and in the planes. */
+static inline void bb_set_square(game g, uint k, color c) {
+  cell_set_color(g, k, c);
+  bb_set_color(g, k / g->width, k % g->width, c);
+}
+
+/* Reads the squares (j-1, j, j+1) of a row as 3 bits, padding included. */
+static inline uint bb_get3(const uint64_t* row, uint j) {
+  if ((j >> 6) == ((j + 2) >> 6)) return (row[j >> 6] >> (j & 63)) & 7;
+  return ((row[j >> 6] >> (j & 63)) | (row[(j >> 6) + 1] << (64 - (j & 63)))) &
+         7;
+}
+
+/* Fills rows and cols with the rows (up, middle, down) and columns (left,
+middle, right) of the window of (i,j), or -1 when they are outside the grid. */
+static inline void bb_window_lines(cgame g, uint i, uint j, int rows[3],
+                                   int cols[3]) {
+  rows[0] = i >= 1 ? (int)i - 1 : (g->wrapping ? g->height - 1 : -1);
+  rows[1] = i;
+  rows[2] = i + 1 < g->height ? (int)i + 1 : (g->wrapping ? 0 : -1);
+  cols[0] = j >= 1 ? (int)j - 1 : (g->wrapping ? g->width - 1 : -1);
+  cols[1] = j;
+  cols[2] = j + 1 < g->width ? (int)j + 1 : (g->wrapping ? 0 : -1);
+}
+
+/* Fills squares with the row-major indexes of the neighbourhood of (i,j) and
+returns their number. The kernels of game_kernels.c call it with constant
+neigh and wrapping. */
+static inline int bb_neighbours_of(cgame g, uint i, uint j, neighbourhood neigh,
+                                   bool wrapping, uint squares[9]) {
+  const uint* masks = bb_masks[neigh];
+  int rows[3] = {-1, i, -1}, cols[3] = {-1, j, -1};
+  if (i >= 1 || wrapping) rows[0] = i >= 1 ? i - 1 : g->height - 1;
+  if (i + 1 < g->height || wrapping) rows[2] = i + 1 < g->height ? i + 1 : 0;
+  if (j >= 1 || wrapping) cols[0] = j >= 1 ? j - 1 : g->width - 1;
+  if (j + 1 < g->width || wrapping) cols[2] = j + 1 < g->width ? j + 1 : 0;
+  int n = 0;
+  for (int r = 0; r < 3; r++) {
+    if (rows[r] < 0) continue;
+    for (int c = 0; c < 3; c++) {
+      if (((masks[r] >> c) & 1) && cols[c] >= 0)
+        squares[n++] = rows[r] * g->width + cols[c];
+    }
+  }
+  return n;
+}
+
+/* Counts the squares, the black squares and the decided squares of the
+neighbourhood of (i,j). Same as bb_neighbours_of for neigh and wrapping. */
+static inline void bb_window_of(cgame g, uint i, uint j, neighbourhood neigh,
+                                bool wrapping, int* nb_squares, int* nb_black,
+                                int* nb_decided) {
+  const uint* masks = bb_masks[neigh];
+  uint columns = 2;
+  if (j >= 1 || wrapping) columns |= 1;
+  if (j + 1 < g->width || wrapping) columns |= 4;
+  int rows[3] = {-1, i, -1};
+  if (i >= 1)
+    rows[0] = i - 1;
+  else if (wrapping)
+    rows[0] = g->height - 1;
+  if (i + 1 < g->height)
+    rows[2] = i + 1;
+  else if (wrapping)
+    rows[2] = 0;
+  int squares = 0, black = 0, decided = 0;
+  for (int r = 0; r < 3; r++) {
+    if (rows[r] < 0) continue;
+    uint mask = masks[r] & columns;
+    squares += bb_count3[mask];
+    black += bb_count3[bb_get3(bb_row(g->black, g, rows[r]), j) & mask];
+    decided += bb_count3[bb_get3(bb_row(g->decided, g, rows[r]), j) & mask];
+  }
+  *nb_squares = squares;
+  *nb_black = black;
+  *nb_decided = decided;
+}
+
+/* Neighbourhood of (i,j), by the kernel of g. */
+static inline int bb_neighbours(cgame g, uint i, uint j, uint squares[9]) {
+  return g->ops->neighbours(g, i, j, squares);
+}
+
+/* Counts of the neighbourhood of (i,j), by the kernel of g. */
+static inline void bb_window(cgame g, uint i, uint j, int* nb_squares,
+                             int* nb_black, int* nb_decided) {
+  g->ops->window(g, i, j, nb_squares, nb_black, nb_decided);
+}
+
+/* Bits of the squares of a row found in its word w, padding excluded. */
+static inline uint64_t bb_squares_mask(cgame g, uint w) {
+  uint64_t mask = ~(uint64_t)0;
+  if (w == 0) mask &= ~(uint64_t)1;
+  if (w == (g->width + 1) >> 6) {
+    uint end = (g->width + 1) & 63;  // bit of the right padding column
+    mask &= ((uint64_t)1 << end) - 1;
+  }
+  return mask;
+}
+
+/* Returns the row-major index of the first EMPTY square at or after from, or
+-1 if every square from there is colored. */
+static inline int bb_next_empty(cgame g, uint from) {
+  uint size = g->height * g->width;
+  while (from < size) {
+    uint i = from / g->width;
+    uint b = from % g->width + 1;
+    const uint64_t* row = bb_row(g->decided, g, i);
+    for (uint w = b >> 6; w <= (g->width >> 6); w++) {
+      uint64_t empty = ~row[w] & bb_squares_mask(g, w);
+      if (w == b >> 6) empty &= ~(uint64_t)0 << (b & 63);
+      if (empty != 0) return i * g->width + 64 * w + __builtin_ctzll(empty) - 1;
+    }
+    from = (i + 1) * g->width;
+  }
+  return -1;
+}
+
+#endif  // __GAME_BITBOARD_H__
@@ -0,0 +1,25 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "game.h"
+#include "game_file.h"
+#include "game_tools.h"
+
+/* Converts a game file between the text format and the binary format (.mosb):
+the format of each file is given by its extension. */
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <input> <output>\n", argv[0]);
+    fprintf(stderr, "A file named *.mosb is binary, any other one is text.\n");
+    return EXIT_FAILURE;
+  }
+  game g = file_has_extension(argv[1], ".mosb") ? game_load_binary(argv[1])
+                                                : game_load(argv[1]);
+  if (g == NULL) return EXIT_FAILURE;
+  if (file_has_extension(argv[2], ".mosb"))
+    game_save_binary(g, argv[2]);
+  else
+    game_save(g, argv[2]);
+  game_delete(g);
+  return EXIT_SUCCESS;
+}
@@ -4,19 +4,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "game_bitboard.h"
+#include "game_kernels.h"
 #include "game_struct.h"
 #endif
 
 game game_new_ext(uint nb_rows, uint nb_cols, constraint *constraints,
                   color *colors, bool wrapping, neighbourhood neigh) {
   game g = game_new_empty_ext(nb_rows, nb_cols, wrapping, neigh);
-  for (int i = 0; i < nb_cols * nb_rows; i++) {
-    g->constraints[i] = constraints[i];
+  for (size_t i = 0; i < (size_t)nb_rows * nb_cols; i++) {
+    game_set_constraint(g, i / nb_cols, i % nb_cols, constraints[i]);
     if (colors != NULL) {
-      g->colors[i] = colors[i];
-    } else {
-      g->colors[i] = EMPTY;
+      game_set_color(g, i / nb_cols, i % nb_cols, colors[i]);
     }
   }
   return g;
@@ -31,20 +32,51 @@ game game_new_empty_ext(uint nb_rows, uint nb_cols, bool wrapping,
   }
   g->height = nb_rows;
   g->width = nb_cols;
-  g->constraints = malloc(nb_rows * nb_cols * sizeof(constraint));
-  g->colors = malloc(nb_rows * nb_cols * sizeof(color));
+  size_t size = (size_t)nb_rows * nb_cols;
+  g->cells = malloc(size * sizeof(uint8_t));
+  g->words = BB_WORDS(nb_cols);
+  g->black = calloc((size_t)nb_rows * g->words, sizeof(uint64_t));
+  g->decided = calloc((size_t)nb_rows * g->words, sizeof(uint64_t));
+  g->windows = malloc(size * sizeof(uint8_t));
   g->neighbourhood = neigh;
   g->wrapping = wrapping;
+  g->ops = game_ops_get(neigh, wrapping);
+  g->neighbours_start = NULL;
+  g->neighbours = NULL;
   g->prv_moves = queue_new();
   g->undone_moves = queue_new();
-  if (g->constraints == NULL || g->colors == NULL) {
+  if (g->cells == NULL || g->black == NULL || g->decided == NULL ||
+      g->windows == NULL) {
     fprintf(stderr, "Memory allocation failed");
     game_delete(g);
     exit(EXIT_FAILURE);
   }
-  for (int i = 0; i < nb_cols * nb_rows; i++) {
-    g->constraints[i] = UNCONSTRAINED;
-    g->colors[i] = EMPTY;
+  // Every square is EMPTY: an unconstrained square is satisfied only if its
+  // neighbourhood has no square.
+  // The number of squares of a neighbourhood only depends on the edges it
+  // touches: the inner rows repeat row 1, and the inner squares of a row
+  // repeat its square 1.
+  memset(g->cells, 0, size);  // EMPTY and UNCONSTRAINED
+  g->nb_empty = size;
+  g->nb_unsatisfied = 0;
+  for (size_t i = 0; i < nb_rows; i++) {
+    uint8_t *row = g->windows + i * nb_cols;
+    if (i >= 2 && i + 1 < nb_rows) {
+      memcpy(row, g->windows + nb_cols, nb_cols);
+    } else {
+      for (uint j = 0; j < nb_cols; j++) {
+        if (j >= 2 && j + 1 < nb_cols) {
+          row[j] = row[1];
+          continue;
+        }
+        int nb_squares, nb_black, nb_decided;
+        g->ops->window(g, i, j, &nb_squares, &nb_black, &nb_decided);
+        row[j] = nb_squares << 4;
+      }
+    }
+    for (uint j = 0; j < nb_cols; j++) {
+      if (row[j] != 0) g->nb_unsatisfied++;
+    }
   }
   return g;
 }
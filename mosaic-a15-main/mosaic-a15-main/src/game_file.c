@@ -0,0 +1,93 @@
+// mmap and opendir
+#define _POSIX_C_SOURCE 200809L
+#include "game_file.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool file_map(const char* filename, mapped_file* f, bool sequential) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "Cannot open %s\n", filename);
+    return false;
+  }
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0;
+  f->data = NULL;
+  f->size = ok ? st.st_size : 0;
+  if (f->size > 0) {
+    void* data = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ok = data != MAP_FAILED;
+    if (ok) {
+      // Read-ahead only pays for the pages read in order.
+      posix_madvise(data, f->size,
+                    sequential ? POSIX_MADV_SEQUENTIAL : POSIX_MADV_RANDOM);
+      f->data = data;
+    }
+  }
+  close(fd);
+  if (!ok) fprintf(stderr, "Cannot read %s\n", filename);
+  return ok;
+}
+
+void file_unmap(mapped_file* f) {
+  if (f->data != NULL) munmap((void*)f->data, f->size);
+}
+
+bool file_has_extension(const char* filename, const char* ext) {
+  size_t length = strlen(filename), ext_length = strlen(ext);
+  return length >= ext_length &&
+         strcmp(filename + length - ext_length, ext) == 0;
+}
+
+static int compare_names(const void* a, const void* b) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* Grows an allocation, or stops the program. */
+static void* file_realloc(void* p, size_t size) {
+  p = realloc(p, size);
+  if (p == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+char** file_list_games(const char* dir, size_t* nb_files) {
+  DIR* d = opendir(dir);
+  if (d == NULL) {
+    fprintf(stderr, "Cannot open %s\n", dir);
+    return NULL;
+  }
+  size_t capacity = 16, n = 0;
+  char** files = file_realloc(NULL, capacity * sizeof(char*));
+  struct dirent* entry;
+  while ((entry = readdir(d)) != NULL) {
+    if (!file_has_extension(entry->d_name, ".txt") &&
+        !file_has_extension(entry->d_name, ".mosb"))
+      continue;
+    if (n == capacity) {
+      capacity *= 2;
+      files = file_realloc(files, capacity * sizeof(char*));
+    }
+    size_t length = strlen(dir) + strlen(entry->d_name) + 2;
+    files[n] = file_realloc(NULL, length);
+    snprintf(files[n++], length, "%s/%s", dir, entry->d_name);
+  }
+  closedir(d);
+  qsort(files, n, sizeof(char*), compare_names);
+  *nb_files = n;
+  return files;
+}
+
+void file_list_free(char** files, size_t nb_files) {
+  for (size_t k = 0; k < nb_files; k++) free(files[k]);
+  free(files);
+}
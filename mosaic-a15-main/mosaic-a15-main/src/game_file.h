@@ -0,0 +1,38 @@
+/**
+ * @file game_file.h
+ * @brief Files mapped in memory, for the loaders of games, and directories of
+ * game files (internal).
+ **/
+
+#ifndef __GAME_FILE_H__
+#define __GAME_FILE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** The content of a file, mapped read-only. */
+typedef struct {
+  const char* data;  // NULL for an empty file
+  size_t size;
+} mapped_file;
+
+/** Maps a whole file in memory, to be read once from start to end if
+ * @p sequential, or else in any order. Returns false, after printing why on
+ * stderr, if it cannot be opened or mapped. */
+bool file_map(const char* filename, mapped_file* f, bool sequential);
+
+void file_unmap(mapped_file* f);
+
+/** Whether a file name ends with @p ext. */
+bool file_has_extension(const char* filename, const char* ext);
+
+/** Returns the paths ("dir/name") of the game files of a directory, those
+ * named *.txt or *.mosb, in the order of their names, and sets @p nb_files to
+ * their number. Returns NULL, after printing why on stderr, if the directory
+ * cannot be read. */
+char** file_list_games(const char* dir, size_t* nb_files);
+
+/** Frees the paths returned by file_list_games. */
+void file_list_free(char** files, size_t nb_files);
+
+#endif  // __GAME_FILE_H__
@@ -0,0 +1,94 @@
+#include "game_kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "game_bitboard.h"
+#include "game_struct.h"
+
+/* Row and column offsets of each direction. */
+static const int next_di[9] = {
+    [HERE] = 0,     [UP] = -1,      [DOWN] = 1,      [LEFT] = 0,
+    [RIGHT] = 0,    [UP_LEFT] = -1, [UP_RIGHT] = -1, [DOWN_LEFT] = 1,
+    [DOWN_RIGHT] = 1};
+static const int next_dj[9] = {
+    [HERE] = 0,      [UP] = 0,       [DOWN] = 0,      [LEFT] = -1,
+    [RIGHT] = 1,     [UP_LEFT] = -1, [UP_RIGHT] = 1,  [DOWN_LEFT] = -1,
+    [DOWN_RIGHT] = 1};
+
+static inline bool next_square_of(cgame g, uint i, uint j, direction dir,
+                                  bool wrapping, uint* pi_next,
+                                  uint* pj_next) {
+  int i_next = (int)i + next_di[dir];
+  int j_next = (int)j + next_dj[dir];
+  if (wrapping) {
+    if (i_next < 0) i_next = g->height - 1;
+    if (i_next == g->height) i_next = 0;
+    if (j_next < 0) j_next = g->width - 1;
+    if (j_next == g->width) j_next = 0;
+  }
+  *pi_next = i_next;
+  *pj_next = j_next;
+  return i_next >= 0 && i_next < g->height && j_next >= 0 &&
+         j_next < g->width;
+}
+
+/* Defines the kernels of neighbourhood neigh, wrapping or not, and their table
+name. */
+#define GAME_KERNELS(name, neigh, wrapping)                                   \
+  static void name##_window(cgame g, uint i, uint j, int* nb_squares,         \
+                            int* nb_black, int* nb_decided) {                 \
+    bb_window_of(g, i, j, neigh, wrapping, nb_squares, nb_black, nb_decided); \
+  }                                                                           \
+  static int name##_neighbours(cgame g, uint i, uint j, uint squares[9]) {    \
+    return bb_neighbours_of(g, i, j, neigh, wrapping, squares);               \
+  }                                                                           \
+  static bool name##_next_square(cgame g, uint i, uint j, direction dir,      \
+                                 uint* pi_next, uint* pj_next) {              \
+    return next_square_of(g, i, j, dir, wrapping, pi_next, pj_next);          \
+  }                                                                           \
+  static const game_ops name = {name##_window, name##_neighbours,             \
+                                name##_next_square};
+
+GAME_KERNELS(full, FULL, false)
+GAME_KERNELS(full_wrap, FULL, true)
+GAME_KERNELS(ortho, ORTHO, false)
+GAME_KERNELS(ortho_wrap, ORTHO, true)
+GAME_KERNELS(full_exclude, FULL_EXCLUDE, false)
+GAME_KERNELS(full_exclude_wrap, FULL_EXCLUDE, true)
+GAME_KERNELS(ortho_exclude, ORTHO_EXCLUDE, false)
+GAME_KERNELS(ortho_exclude_wrap, ORTHO_EXCLUDE, true)
+
+static const game_ops* const kernels[4][2] = {
+    [FULL] = {&full, &full_wrap},
+    [ORTHO] = {&ortho, &ortho_wrap},
+    [FULL_EXCLUDE] = {&full_exclude, &full_exclude_wrap},
+    [ORTHO_EXCLUDE] = {&ortho_exclude, &ortho_exclude_wrap}};
+
+const game_ops* game_ops_get(neighbourhood neigh, bool wrapping) {
+  return kernels[neigh][wrapping];
+}
+
+void game_neighbours_build(game g) {
+  if (g->neighbours_start != NULL ||
+      (size_t)g->height * g->width > NEIGHBOURS_TABLE_MAX_SQUARES)
+    return;
+  uint size = g->height * g->width;
+  uint* start = malloc((size + 1) * sizeof(uint));
+  uint* neighbours = malloc((size_t)9 * size * sizeof(uint));
+  if (start == NULL || neighbours == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  start[0] = 0;
+  for (uint k = 0; k < size; k++) {
+    int n = g->ops->neighbours(g, k / g->width, k % g->width,
+                               neighbours + start[k]);
+    start[k + 1] = start[k] + n;
+  }
+  // Give back the slots left unused by the edges and the smaller
+  // neighbourhoods.
+  uint* shrunk = realloc(neighbours, (start[size] + 1) * sizeof(uint));
+  g->neighbours = shrunk != NULL ? shrunk : neighbours;
+  g->neighbours_start = start;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file game_kernels.h
+ * @brief Neighbourhood kernels specialized for each kind of game (internal).
+ * @details The neighbourhood and the wrapping of a game are fixed when it is
+ * created. game_new_empty_ext then picks, in @ref game_s::ops, the kernels
+ * compiled for its combination, where both are constants: the masks of the
+ * window are known and the tests of the edges that cannot apply are gone.
+ * The solver walks the neighbourhoods from a table of their indexes instead,
+ * built from these kernels in compressed sparse row form.
+ **/
+
+#ifndef __GAME_KERNELS_H__
+#define __GAME_KERNELS_H__
+
+#include <stddef.h>
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_struct.h"
+
+/** Kernels of one neighbourhood and wrapping. */
+typedef struct game_ops {
+  /** Counts the squares, the black squares and the decided squares of the
+   * neighbourhood of (i,j), from the bit planes. */
+  void (*window)(cgame g, uint i, uint j, int* nb_squares, int* nb_black,
+                 int* nb_decided);
+  /** Fills squares with the row-major indexes of the neighbourhood of (i,j)
+   * and returns their number. */
+  int (*neighbours)(cgame g, uint i, uint j, uint squares[9]);
+  /** Same as game_get_next_square. */
+  bool (*next_square)(cgame g, uint i, uint j, direction dir, uint* pi_next,
+                      uint* pj_next);
+} game_ops;
+
+/** Returns the kernels of the games of neighbourhood @p neigh, wrapping or
+ * not. */
+const game_ops* game_ops_get(neighbourhood neigh, bool wrapping);
+
+/** Fills the neighbourhood table of @p g, see game_neighbours, unless it is
+ * already built or the game is too large for one. */
+void game_neighbours_build(game g);
+
+/** Largest number of squares of a game whose neighbourhood table is built:
+ * beyond, its 40 bytes per square are more than the rest of the solver needs,
+ * and the neighbourhoods are computed on each call. */
+#define NEIGHBOURS_TABLE_MAX_SQUARES (1u << 24)
+
+/** Returns the row-major indexes of the neighbourhood of square @p k, as listed
+ * by the neighbours kernel, and sets @p n to their number. They are read from
+ * the table of @p g once game_neighbours_build has filled it, which the solver
+ * does on its own copies of the games, and are written to @p buffer otherwise:
+ * @p g is only read. */
+static inline const uint* game_neighbours(cgame g, uint k, int* n,
+                                          uint buffer[9]) {
+  if (g->neighbours_start == NULL) {
+    *n = g->ops->neighbours(g, k / g->width, k % g->width, buffer);
+    return buffer;
+  }
+  *n = g->neighbours_start[k + 1] - g->neighbours_start[k];
+  return g->neighbours + g->neighbours_start[k];
+}
+
+#endif  // __GAME_KERNELS_H__
@@ -0,0 +1,168 @@
+#include "game_pack.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_file.h"
+#include "game_tools.h"
+
+#define MOSP_VERSION 1
+#define MOSP_HEADER_SIZE 24
+
+struct game_pack_s {
+  mapped_file f;
+  bool binary;
+  size_t count;
+  uint64_t index_offset;
+};
+
+struct game_pack_writer_s {
+  FILE* f;
+  bool binary;
+  uint64_t* offsets;  // of the records written so far, and of the next one
+  size_t count;
+  size_t capacity;    // of offsets
+  char* buffer;       // holds a record
+  size_t buffer_size;
+};
+
+static uint64_t read_u64(const uint8_t* p) {
+  uint64_t v = 0;
+  for (int b = 7; b >= 0; b--) v = v << 8 | p[b];
+  return v;
+}
+
+static void write_u64(uint8_t* p, uint64_t v) {
+  for (int b = 0; b < 8; b++) p[b] = v >> (8 * b);
+}
+
+static void* pack_alloc(void* p, size_t size) {
+  p = realloc(p, size);
+  if (p == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+/* Checks the header and the size of the index. Returns NULL if they are
+valid, or what is wrong. */
+static const char* mosp_check(const uint8_t* data, size_t size) {
+  if (data == NULL || size < MOSP_HEADER_SIZE || memcmp(data, "MOSP", 4) != 0)
+    return "not a pack file";
+  if (data[4] != MOSP_VERSION) return "unknown version";
+  if (data[5] > 1 || data[6] != 0 || data[7] != 0) return "invalid header";
+  uint64_t count = read_u64(data + 8), index_offset = read_u64(data + 16);
+  // count + 1 could wrap: the index is checked against count from its size.
+  if (index_offset < MOSP_HEADER_SIZE || index_offset > size ||
+      size - index_offset < 8 || (size - index_offset) % 8 != 0 ||
+      (size - index_offset) / 8 - 1 != count)
+    return "invalid index";
+  return NULL;
+}
+
+game_pack game_pack_open(const char* filename) {
+  mapped_file f;
+  // The games are read by index, in any order.
+  if (!file_map(filename, &f, false)) return NULL;
+  const uint8_t* data = (const uint8_t*)f.data;
+  const char* error = mosp_check(data, f.size);
+  if (error != NULL) {
+    fprintf(stderr, "%s: %s\n", filename, error);
+    file_unmap(&f);
+    return NULL;
+  }
+  game_pack p = pack_alloc(NULL, sizeof(struct game_pack_s));
+  p->f = f;
+  p->binary = data[5] == 1;
+  p->count = read_u64(data + 8);
+  p->index_offset = read_u64(data + 16);
+  return p;
+}
+
+size_t game_pack_count(game_pack p) { return p->count; }
+
+game game_pack_get(game_pack p, size_t i) {
+  if (i >= p->count) {
+    fprintf(stderr, "No game %zu in a pack of %zu\n", i, p->count);
+    return NULL;
+  }
+  const uint8_t* entry = (const uint8_t*)p->f.data + p->index_offset + 8 * i;
+  uint64_t start = read_u64(entry), end = read_u64(entry + 8);
+  if (start < MOSP_HEADER_SIZE || start > end || end > p->index_offset) {
+    fprintf(stderr, "Invalid offsets of game %zu in the pack\n", i);
+    return NULL;
+  }
+  const char* record = p->f.data + start;
+  if (p->binary) return game_load_binary_from_buffer(record, end - start);
+  return game_load_from_buffer(record, end - start);
+}
+
+void game_pack_close(game_pack p) {
+  file_unmap(&p->f);
+  free(p);
+}
+
+game_pack_writer game_pack_create(const char* filename, bool binary) {
+  FILE* f = fopen(filename, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open %s\n", filename);
+    return NULL;
+  }
+  // The header is written again by game_pack_finish, once the index is known.
+  uint8_t header[MOSP_HEADER_SIZE] = {0};
+  fwrite(header, 1, MOSP_HEADER_SIZE, f);
+  game_pack_writer w = pack_alloc(NULL, sizeof(struct game_pack_writer_s));
+  w->f = f;
+  w->binary = binary;
+  w->capacity = 1024;
+  w->offsets = pack_alloc(NULL, w->capacity * sizeof(uint64_t));
+  w->offsets[0] = MOSP_HEADER_SIZE;
+  w->count = 0;
+  w->buffer = NULL;
+  w->buffer_size = 0;
+  return w;
+}
+
+void game_pack_add(game_pack_writer w, cgame g) {
+  size_t size = w->binary ? game_save_binary_to_buffer(g, NULL, 0)
+                          : game_save_to_buffer(g, NULL, 0);
+  if (size > w->buffer_size) {
+    w->buffer = pack_alloc(w->buffer, size);
+    w->buffer_size = size;
+  }
+  if (w->binary)
+    game_save_binary_to_buffer(g, w->buffer, size);
+  else
+    game_save_to_buffer(g, w->buffer, size);
+  fwrite(w->buffer, 1, size, w->f);
+  if (w->count + 2 > w->capacity) {
+    w->capacity *= 2;
+    w->offsets = pack_alloc(w->offsets, w->capacity * sizeof(uint64_t));
+  }
+  w->count++;
+  w->offsets[w->count] = w->offsets[w->count - 1] + size;
+}
+
+bool game_pack_finish(game_pack_writer w) {
+  uint64_t index_offset = w->offsets[w->count];
+  for (size_t i = 0; i <= w->count; i++) {
+    uint8_t entry[8];
+    write_u64(entry, w->offsets[i]);
+    fwrite(entry, 1, 8, w->f);
+  }
+  uint8_t header[MOSP_HEADER_SIZE] = {'M', 'O', 'S', 'P', MOSP_VERSION,
+                                      w->binary};
+  write_u64(header + 8, w->count);
+  write_u64(header + 16, index_offset);
+  bool ok = fseek(w->f, 0, SEEK_SET) == 0 &&
+            fwrite(header, 1, MOSP_HEADER_SIZE, w->f) == MOSP_HEADER_SIZE;
+  ok = !ferror(w->f) && ok;
+  ok = fclose(w->f) == 0 && ok;
+  free(w->offsets);
+  free(w->buffer);
+  free(w);
+  return ok;
+}
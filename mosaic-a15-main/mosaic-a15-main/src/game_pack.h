@@ -0,0 +1,76 @@
+/**
+ * @file game_pack.h
+ * @brief Packs of games: many games in one file, read in any order.
+ * @details A pack (.mosp), version 1, starts with a 24-byte header: the 4
+ * characters "MOSP", the version, the encoding of its games (0 for the text
+ * format of @ref game_save, 1 for the binary format of @ref game_save_binary),
+ * two zero bytes, then the number of games n and the offset of the index, as
+ * 64-bit little-endian integers. The games follow, one record each, in the
+ * encoding of the pack. The index ends the file: n + 1 offsets from the start
+ * of the file, as 64-bit little-endian integers, where record i starts at
+ * offset i and ends at offset i + 1.
+ *
+ * A pack is mapped in memory when opened, with no parsing of its records: a
+ * game is decoded only when it is asked for.
+ **/
+
+#ifndef __GAME_PACK_H__
+#define __GAME_PACK_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "game.h"
+
+/** A pack opened for reading. */
+typedef struct game_pack_s* game_pack;
+
+/** A pack being written. */
+typedef struct game_pack_writer_s* game_pack_writer;
+
+/**
+ * @brief Opens a pack.
+ * @details Only the header and the size of the index are checked.
+ * @param filename the pack file
+ * @return the pack, or NULL if the file cannot be read or is not a valid pack;
+ * the reason is then printed on stderr
+ **/
+game_pack game_pack_open(const char* filename);
+
+/** Number of games of a pack. */
+size_t game_pack_count(game_pack p);
+
+/**
+ * @brief Creates game @p i of a pack, decoded from its record.
+ * @details The pack is only read: several threads can get games from it at the
+ * same time.
+ * @param p the pack
+ * @param i index of the game, from 0
+ * @return the game, or NULL if @p i is out of range or the record is not a
+ * valid game; the reason is then printed on stderr
+ **/
+game game_pack_get(game_pack p, size_t i);
+
+/** Closes a pack. The games created from it are kept. */
+void game_pack_close(game_pack p);
+
+/**
+ * @brief Starts writing a pack.
+ * @param filename the pack file
+ * @param binary whether the games are saved in the binary format rather than
+ * in the text one
+ * @return the writer, or NULL if the file cannot be created; the reason is then
+ * printed on stderr
+ **/
+game_pack_writer game_pack_create(const char* filename, bool binary);
+
+/** Adds a game at the end of a pack. */
+void game_pack_add(game_pack_writer w, cgame g);
+
+/**
+ * @brief Writes the index of a pack and closes it.
+ * @return whether the whole pack was written
+ **/
+bool game_pack_finish(game_pack_writer w);
+
+#endif  // __GAME_PACK_H__
@@ -0,0 +1,100 @@
+// stat
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "game.h"
+#include "game_file.h"
+#include "game_pack.h"
+#include "game_tools.h"
+
+game load(const char* filename) {
+  char* name = (char*)filename;
+  return file_has_extension(name, ".mosb") ? game_load_binary(name)
+                                           : game_load(name);
+}
+
+/* Adds the game of a file to the pack, or every game of a directory: its files
+named *.txt or *.mosb, in the order of their names. Returns false if a game
+cannot be loaded. */
+bool add_path(game_pack_writer w, const char* path, size_t* nb_games) {
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  if (!S_ISDIR(st.st_mode)) {
+    game g = load(path);
+    if (g == NULL) return false;
+    game_pack_add(w, g);
+    game_delete(g);
+    (*nb_games)++;
+    return true;
+  }
+  size_t nb_files;
+  char** files = file_list_games(path, &nb_files);
+  if (files == NULL) return false;
+  bool ok = true;
+  for (size_t k = 0; k < nb_files && ok; k++)
+    ok = add_path(w, files[k], nb_games);
+  file_list_free(files, nb_files);
+  return ok;
+}
+
+void usage(char* argv[]) {
+  fprintf(stderr, "Usage: %s [-b] <pack> <input>...\n", argv[0]);
+  fprintf(stderr, "       %s -c <pack>\n", argv[0]);
+  fprintf(stderr, "       %s -x <pack> <index> <output>\n", argv[0]);
+  fprintf(stderr,
+          "Builds a pack from game files and directories (their *.txt and "
+          "*.mosb files),\nin text or with -b in binary. -c prints the number "
+          "of games of a pack, and -x\nsaves one of them, in binary if the "
+          "output is named *.mosb.\n");
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) usage(argv);
+  if (strcmp(argv[1], "-c") == 0 || strcmp(argv[1], "-x") == 0) {
+    bool extract = argv[1][1] == 'x';
+    if (argc != (extract ? 5 : 3)) usage(argv);
+    game_pack p = game_pack_open(argv[2]);
+    if (p == NULL) return EXIT_FAILURE;
+    if (!extract) {
+      printf("%zu\n", game_pack_count(p));
+      game_pack_close(p);
+      return EXIT_SUCCESS;
+    }
+    game g = game_pack_get(p, strtoull(argv[3], NULL, 10));
+    game_pack_close(p);
+    if (g == NULL) return EXIT_FAILURE;
+    if (file_has_extension(argv[4], ".mosb"))
+      game_save_binary(g, argv[4]);
+    else
+      game_save(g, argv[4]);
+    game_delete(g);
+    return EXIT_SUCCESS;
+  }
+
+  bool binary = strcmp(argv[1], "-b") == 0;
+  int first = binary ? 3 : 2;
+  if (argc <= first) usage(argv);
+  char* pack = argv[first - 1];
+  game_pack_writer w = game_pack_create(pack, binary);
+  if (w == NULL) return EXIT_FAILURE;
+  size_t nb_games = 0;
+  bool ok = true;
+  for (int a = first; a < argc && ok; a++) ok = add_path(w, argv[a], &nb_games);
+  if (!game_pack_finish(w)) {
+    fprintf(stderr, "Cannot write %s\n", pack);
+    ok = false;
+  }
+  if (!ok) {
+    remove(pack);
+    return EXIT_FAILURE;
+  }
+  printf("%zu games written to %s\n", nb_games, pack);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,513 @@
+#include "game_sat.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void* sat_alloc(size_t size) {
+  void* p = malloc(size);
+  if (p == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+void* sat_calloc(size_t nb, size_t size) {
+  void* p = calloc(nb, size);
+  if (p == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+void cnf_init(cnf* f) {
+  f->nb_vars = 0;
+  f->nb_clauses = 0;
+  f->size = 0;
+  f->capacity = 1024;
+  f->lits = sat_alloc(f->capacity * sizeof(int));
+}
+
+void cnf_free(cnf* f) { free(f->lits); }
+
+int cnf_new_var(cnf* f) { return ++f->nb_vars; }
+
+void cnf_add_clause(cnf* f, const int lits[], int n) {
+  while (f->size + n + 1 > f->capacity) {
+    f->capacity *= 2;
+    f->lits = realloc(f->lits, f->capacity * sizeof(int));
+    if (f->lits == NULL) {
+      fprintf(stderr, "Memory allocation failed");
+      exit(EXIT_FAILURE);
+    }
+  }
+  for (int k = 0; k < n; k++) f->lits[f->size++] = lits[k];
+  f->lits[f->size++] = 0;
+  f->nb_clauses++;
+}
+
+void cnf_print(const cnf* f, FILE* out) {
+  fprintf(out, "p cnf %d %d\n", f->nb_vars, f->nb_clauses);
+  for (size_t k = 0; k < f->size; k++) {
+    if (f->lits[k] == 0)
+      fprintf(out, "0\n");
+    else
+      fprintf(out, "%d ", f->lits[k]);
+  }
+}
+
+/* Inside the solver, the literals of variable v (numbered from 0) are 2v when
+it is true and 2v+1 when it is false, and a literal is negated by flipping its
+lowest bit. */
+
+typedef struct {
+  int size;
+  bool learnt;
+  double activity;
+  int lits[];  // lits[0] and lits[1] are watched
+} clause;
+
+typedef struct {
+  clause** data;
+  int size;
+  int capacity;
+} clause_list;
+
+void clause_list_push(clause_list* l, clause* c) {
+  if (l->size == l->capacity) {
+    l->capacity = l->capacity == 0 ? 4 : 2 * l->capacity;
+    l->data = realloc(l->data, l->capacity * sizeof(clause*));
+    if (l->data == NULL) {
+      fprintf(stderr, "Memory allocation failed");
+      exit(EXIT_FAILURE);
+    }
+  }
+  l->data[l->size++] = c;
+}
+
+typedef struct {
+  int nb_vars;
+  signed char* values;  // 1 true, 0 false, -1 unassigned
+  int* levels;
+  clause** reasons;  // clause that implied each variable, NULL for decisions
+  bool* phases;      // last value of each variable
+  char* seen;        // used by the conflict analysis
+  int* trail;        // assigned literals, in order
+  int trail_size;
+  int head;         // first literal of the trail still to propagate
+  int* trail_lims;  // trail size at the start of each decision level
+  int nb_levels;
+  clause_list* watches;  // for each literal, the clauses watching it
+  clause_list clauses;
+  clause_list learnts;
+  int max_learnts;
+  double* activities;  // VSIDS activity of the variables
+  double var_inc;
+  double clause_inc;
+  int* heap;  // unassigned variables, max-heap on activity
+  int heap_size;
+  int* heap_index;  // position of each variable in heap, -1 if absent
+  bool unsat;       // the empty clause was derived
+} solver;
+
+int lit_value(const solver* s, int l) {
+  signed char v = s->values[l >> 1];
+  return v < 0 ? -1 : v ^ (l & 1);
+}
+
+/* Binary max-heap of the variables ordered by activity. */
+
+void heap_swap(solver* s, int a, int b) {
+  int va = s->heap[a], vb = s->heap[b];
+  s->heap[a] = vb;
+  s->heap[b] = va;
+  s->heap_index[vb] = a;
+  s->heap_index[va] = b;
+}
+
+void heap_up(solver* s, int k) {
+  while (k > 0 && s->activities[s->heap[(k - 1) / 2]] <
+                      s->activities[s->heap[k]]) {
+    heap_swap(s, k, (k - 1) / 2);
+    k = (k - 1) / 2;
+  }
+}
+
+void heap_down(solver* s, int k) {
+  while (true) {
+    int best = k;
+    for (int child = 2 * k + 1; child <= 2 * k + 2; child++) {
+      if (child < s->heap_size &&
+          s->activities[s->heap[child]] > s->activities[s->heap[best]])
+        best = child;
+    }
+    if (best == k) return;
+    heap_swap(s, k, best);
+    k = best;
+  }
+}
+
+void heap_insert(solver* s, int v) {
+  if (s->heap_index[v] >= 0) return;
+  s->heap[s->heap_size] = v;
+  s->heap_index[v] = s->heap_size;
+  s->heap_size++;
+  heap_up(s, s->heap_size - 1);
+}
+
+int heap_pop(solver* s) {
+  int v = s->heap[0];
+  heap_swap(s, 0, s->heap_size - 1);
+  s->heap_size--;
+  s->heap_index[v] = -1;
+  if (s->heap_size > 0) heap_down(s, 0);
+  return v;
+}
+
+void bump_var(solver* s, int v) {
+  s->activities[v] += s->var_inc;
+  if (s->activities[v] > 1e100) {
+    for (int k = 0; k < s->nb_vars; k++) s->activities[k] *= 1e-100;
+    s->var_inc *= 1e-100;
+  }
+  if (s->heap_index[v] >= 0) heap_up(s, s->heap_index[v]);
+}
+
+void bump_clause(solver* s, clause* c) {
+  c->activity += s->clause_inc;
+  if (c->activity > 1e20) {
+    for (int k = 0; k < s->learnts.size; k++)
+      s->learnts.data[k]->activity *= 1e-20;
+    s->clause_inc *= 1e-20;
+  }
+}
+
+void enqueue(solver* s, int l, clause* reason) {
+  int v = l >> 1;
+  s->values[v] = (l & 1) ^ 1;
+  s->levels[v] = s->nb_levels;
+  s->reasons[v] = reason;
+  s->trail[s->trail_size++] = l;
+}
+
+clause* new_clause(const int lits[], int size, bool learnt) {
+  clause* c = sat_alloc(sizeof(clause) + size * sizeof(int));
+  c->size = size;
+  c->learnt = learnt;
+  c->activity = 0;
+  memcpy(c->lits, lits, size * sizeof(int));
+  return c;
+}
+
+void attach_clause(solver* s, clause* c) {
+  clause_list_push(&s->watches[c->lits[0]], c);
+  clause_list_push(&s->watches[c->lits[1]], c);
+}
+
+/* Propagates the literals of the trail not propagated yet, and returns a
+clause with all its literals false if there is one, NULL otherwise. */
+clause* propagate(solver* s) {
+  while (s->head < s->trail_size) {
+    int false_lit = s->trail[s->head++] ^ 1;
+    clause_list* ws = &s->watches[false_lit];
+    int i = 0, j = 0;
+    while (i < ws->size) {
+      clause* c = ws->data[i++];
+      // The false literal goes to lits[1].
+      if (c->lits[0] == false_lit) {
+        c->lits[0] = c->lits[1];
+        c->lits[1] = false_lit;
+      }
+      if (lit_value(s, c->lits[0]) == 1) {
+        ws->data[j++] = c;
+        continue;
+      }
+      bool moved = false;
+      for (int k = 2; k < c->size; k++) {
+        if (lit_value(s, c->lits[k]) != 0) {
+          c->lits[1] = c->lits[k];
+          c->lits[k] = false_lit;
+          clause_list_push(&s->watches[c->lits[1]], c);
+          moved = true;
+          break;
+        }
+      }
+      if (moved) continue;
+      ws->data[j++] = c;
+      if (lit_value(s, c->lits[0]) == 0) {
+        while (i < ws->size) ws->data[j++] = ws->data[i++];
+        ws->size = j;
+        s->head = s->trail_size;
+        return c;
+      }
+      enqueue(s, c->lits[0], c);
+    }
+    ws->size = j;
+  }
+  return NULL;
+}
+
+/* Whether literal l of the learnt clause is implied by the other ones, that is
+whether every other literal of its reason is in the clause or fixed at level
+0. */
+bool redundant(const solver* s, int l) {
+  const clause* r = s->reasons[l >> 1];
+  if (r == NULL) return false;
+  for (int k = 1; k < r->size; k++) {
+    int v = r->lits[k] >> 1;
+    if (!s->seen[v] && s->levels[v] > 0) return false;
+  }
+  return true;
+}
+
+/* Derives from a conflict the clause of its first unique implication point,
+in learnt, and returns its size. learnt[0] is the literal asserted once
+backtracked, and learnt[1] the one of the highest level among the others. */
+int analyze(solver* s, clause* conflict, int learnt[]) {
+  int size = 1;
+  int nb_pending = 0;  // literals of the current level left to resolve
+  int l = -1;
+  int index = s->trail_size - 1;
+  do {
+    if (conflict->learnt) bump_clause(s, conflict);
+    for (int k = (l == -1 ? 0 : 1); k < conflict->size; k++) {
+      int q = conflict->lits[k];
+      int v = q >> 1;
+      if (!s->seen[v] && s->levels[v] > 0) {
+        s->seen[v] = 1;
+        bump_var(s, v);
+        if (s->levels[v] >= s->nb_levels)
+          nb_pending++;
+        else
+          learnt[size++] = q;
+      }
+    }
+    while (!s->seen[s->trail[index] >> 1]) index--;
+    l = s->trail[index];
+    index--;
+    conflict = s->reasons[l >> 1];
+    s->seen[l >> 1] = 0;
+    nb_pending--;
+  } while (nb_pending > 0);
+  learnt[0] = l ^ 1;
+
+  // The literals implied by the other ones are marked 2, and removed once seen
+  // is reset.
+  for (int k = 1; k < size; k++) {
+    if (redundant(s, learnt[k])) s->seen[learnt[k] >> 1] = 2;
+  }
+  int kept = 1;
+  for (int k = 1; k < size; k++) {
+    if (s->seen[learnt[k] >> 1] == 1) learnt[kept++] = learnt[k];
+    s->seen[learnt[k] >> 1] = 0;
+  }
+  size = kept;
+
+  int best = 1;
+  for (int k = 2; k < size; k++) {
+    if (s->levels[learnt[k] >> 1] > s->levels[learnt[best] >> 1]) best = k;
+  }
+  if (size > 1) {
+    int tmp = learnt[1];
+    learnt[1] = learnt[best];
+    learnt[best] = tmp;
+  }
+  return size;
+}
+
+void backtrack(solver* s, int level) {
+  if (s->nb_levels <= level) return;
+  for (int k = s->trail_size - 1; k >= s->trail_lims[level]; k--) {
+    int v = s->trail[k] >> 1;
+    s->phases[v] = s->values[v];
+    s->values[v] = -1;
+    s->reasons[v] = NULL;
+    heap_insert(s, v);
+  }
+  s->trail_size = s->head = s->trail_lims[level];
+  s->nb_levels = level;
+}
+
+int compare_activities(const void* a, const void* b) {
+  double x = (*(clause* const*)a)->activity;
+  double y = (*(clause* const*)b)->activity;
+  return (x > y) - (x < y);
+}
+
+/* Forgets the less active half of the learnt clauses, keeping the binary ones.
+Only called at level 0, where no learnt clause is needed as a reason. */
+void reduce_learnts(solver* s) {
+  qsort(s->learnts.data, s->learnts.size, sizeof(clause*),
+        compare_activities);
+  int half = s->learnts.size / 2;
+  int kept = 0;
+  for (int k = 0; k < s->learnts.size; k++) {
+    clause* c = s->learnts.data[k];
+    if (k < half && c->size > 2) {
+      for (int l = 0; l < c->size; l++) {
+        int v = c->lits[l] >> 1;
+        if (s->reasons[v] == c) s->reasons[v] = NULL;
+      }
+      free(c);
+    } else {
+      s->learnts.data[kept++] = c;
+    }
+  }
+  s->learnts.size = kept;
+  for (int l = 0; l < 2 * s->nb_vars; l++) s->watches[l].size = 0;
+  for (int k = 0; k < s->clauses.size; k++)
+    attach_clause(s, s->clauses.data[k]);
+  for (int k = 0; k < s->learnts.size; k++)
+    attach_clause(s, s->learnts.data[k]);
+}
+
+/* Adds a clause of the formula, given in DIMACS literals. */
+void add_clause(solver* s, const int dimacs[], int n, int lits[]) {
+  int size = 0;
+  for (int k = 0; k < n; k++) {
+    int l = dimacs[k] > 0 ? 2 * (dimacs[k] - 1) : 2 * (-dimacs[k] - 1) + 1;
+    bool duplicate = false;
+    for (int m = 0; m < size; m++) {
+      if (lits[m] == (l ^ 1)) return;  // always true
+      if (lits[m] == l) duplicate = true;
+    }
+    if (!duplicate) lits[size++] = l;
+  }
+  if (size == 0) {
+    s->unsat = true;
+  } else if (size == 1) {
+    int value = lit_value(s, lits[0]);
+    if (value == 0) s->unsat = true;
+    if (value == -1) enqueue(s, lits[0], NULL);
+  } else {
+    clause* c = new_clause(lits, size, false);
+    clause_list_push(&s->clauses, c);
+    attach_clause(s, c);
+  }
+}
+
+/* Luby sequence 1, 1, 2, 1, 1, 2, 4, 1, ... of the restart intervals. */
+int luby(int k) {
+  int size = 1, power = 1;
+  while (size < k + 1) {
+    size = 2 * size + 1;
+    power *= 2;
+  }
+  while (size - 1 != k) {
+    size = (size - 1) / 2;
+    power /= 2;
+    k = k % size;
+  }
+  return power;
+}
+
+bool cnf_solve(const cnf* f, bool model[]) {
+  solver s;
+  int n = f->nb_vars;
+  s.nb_vars = n;
+  s.values = sat_alloc(n * sizeof(signed char) + 1);
+  memset(s.values, -1, n * sizeof(signed char));
+  s.levels = sat_calloc(n + 1, sizeof(int));
+  s.reasons = sat_calloc(n + 1, sizeof(clause*));
+  s.phases = sat_calloc(n + 1, sizeof(bool));
+  s.seen = sat_calloc(n + 1, sizeof(char));
+  s.trail = sat_alloc((n + 1) * sizeof(int));
+  s.trail_size = s.head = 0;
+  s.trail_lims = sat_alloc((n + 1) * sizeof(int));
+  s.nb_levels = 0;
+  s.watches = sat_calloc(2 * n + 1, sizeof(clause_list));
+  s.clauses = (clause_list){NULL, 0, 0};
+  s.learnts = (clause_list){NULL, 0, 0};
+  s.activities = sat_calloc(n + 1, sizeof(double));
+  s.var_inc = s.clause_inc = 1;
+  s.heap = sat_alloc((n + 1) * sizeof(int));
+  s.heap_index = sat_alloc((n + 1) * sizeof(int));
+  s.heap_size = 0;
+  for (int v = 0; v < n; v++) {
+    s.heap_index[v] = -1;
+    heap_insert(&s, v);
+  }
+  s.unsat = false;
+
+  int* lits = sat_alloc((n + 1) * sizeof(int));
+  size_t start = 0;
+  for (size_t k = 0; k < f->size && !s.unsat; k++) {
+    if (f->lits[k] == 0) {
+      add_clause(&s, f->lits + start, k - start, lits);
+      start = k + 1;
+    }
+  }
+  s.max_learnts = s.clauses.size / 3 + 1000;
+
+  int nb_restarts = 0;
+  int nb_conflicts = 0;  // since the last restart
+  bool sat = false;
+  while (!s.unsat) {
+    clause* conflict = propagate(&s);
+    if (conflict != NULL) {
+      if (s.nb_levels == 0) {
+        s.unsat = true;
+        break;
+      }
+      nb_conflicts++;
+      int size = analyze(&s, conflict, lits);
+      backtrack(&s, size > 1 ? s.levels[lits[1] >> 1] : 0);
+      if (size == 1) {
+        enqueue(&s, lits[0], NULL);
+      } else {
+        clause* c = new_clause(lits, size, true);
+        clause_list_push(&s.learnts, c);
+        attach_clause(&s, c);
+        bump_clause(&s, c);
+        enqueue(&s, lits[0], c);
+      }
+      s.var_inc /= 0.95;
+      s.clause_inc /= 0.999;
+      continue;
+    }
+    if (nb_conflicts >= 100 * luby(nb_restarts)) {
+      nb_conflicts = 0;
+      nb_restarts++;
+      backtrack(&s, 0);
+      if (s.learnts.size >= s.max_learnts) {
+        reduce_learnts(&s);
+        s.max_learnts += s.max_learnts / 10;
+      }
+      continue;
+    }
+    int v = -1;
+    while (s.heap_size > 0 && v < 0) {
+      v = heap_pop(&s);
+      if (s.values[v] >= 0) v = -1;
+    }
+    if (v < 0) {
+      sat = true;
+      break;
+    }
+    s.trail_lims[s.nb_levels++] = s.trail_size;
+    enqueue(&s, 2 * v + (s.phases[v] ? 0 : 1), NULL);
+  }
+
+  if (sat) {
+    for (int v = 0; v < n; v++) model[v] = s.values[v] == 1;
+  }
+  for (int k = 0; k < s.clauses.size; k++) free(s.clauses.data[k]);
+  for (int k = 0; k < s.learnts.size; k++) free(s.learnts.data[k]);
+  for (int l = 0; l < 2 * n; l++) free(s.watches[l].data);
+  free(s.clauses.data);
+  free(s.learnts.data);
+  free(s.watches);
+  free(s.values);
+  free(s.levels);
+  free(s.reasons);
+  free(s.phases);
+  free(s.seen);
+  free(s.trail);
+  free(s.trail_lims);
+  free(s.activities);
+  free(s.heap);
+  free(s.heap_index);
+  free(lits);
+  return sat;
+}
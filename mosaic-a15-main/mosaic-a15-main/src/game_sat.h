@@ -0,0 +1,50 @@
+/**
+ * @file game_sat.h
+ * @brief Formulas in conjunctive normal form and a small CDCL SAT solver.
+ * @details The literals follow the DIMACS convention: variable v is numbered
+ * from 1, and is written v when it is true and -v when it is false.
+ **/
+
+#ifndef __GAME_SAT_H__
+#define __GAME_SAT_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/** A formula in conjunctive normal form. */
+typedef struct {
+  int nb_vars;
+  int nb_clauses;
+  int* lits;        // the clauses one after the other, each ended by a 0
+  size_t size;      // of lits
+  size_t capacity;  // of lits
+} cnf;
+
+/** Initializes an empty formula. */
+void cnf_init(cnf* f);
+
+/** Frees the clauses of a formula. */
+void cnf_free(cnf* f);
+
+/** Adds a new variable to a formula and returns it. */
+int cnf_new_var(cnf* f);
+
+/** Adds the clause of the @p n literals of @p lits to a formula. An empty
+ * clause makes the formula unsatisfiable. */
+void cnf_add_clause(cnf* f, const int lits[], int n);
+
+/** Writes a formula in the DIMACS format. */
+void cnf_print(const cnf* f, FILE* out);
+
+/**
+ * @brief Decides whether a formula is satisfiable.
+ * @details Conflict-driven clause learning: two watched literals per clause,
+ * first UIP learning, VSIDS branching with phase saving and Luby restarts.
+ * @param f the formula
+ * @param model if the formula is satisfiable, model[v-1] is set to the value of
+ * variable v in a satisfying assignment
+ * @return true if the formula is satisfiable
+ **/
+bool cnf_solve(const cnf* f, bool model[]);
+
+#endif  // __GAME_SAT_H__
@@ -1,22 +1,243 @@
 
+// clock_gettime and sysconf
+#define _POSIX_C_SOURCE 200809L
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "game_aux.h"
+#include "game_file.h"
+#include "game_pack.h"
 #include "game_struct.h"
 #include "game_tools.h"
+
+typedef struct {
+  FILE* out;
+  uint nb_rows;
+  uint nb_cols;
+} solution_writer;
+
+/* Writes a solution as one line of 'w' and 'b' per row, followed by an empty
+line. */
+bool write_solution(const color colors[], void* ctx) {
+  solution_writer* w = ctx;
+  for (uint i = 0; i < w->nb_rows; i++) {
+    for (uint j = 0; j < w->nb_cols; j++) {
+      fputc(colors[i * w->nb_cols + j] == BLACK ? 'b' : 'w', w->out);
+    }
+    fputc('\n', w->out);
+  }
+  fputc('\n', w->out);
+  return true;
+}
+
+/* Reads the name of a branching heuristic. Returns false if it is unknown. */
+bool parse_branching(const char* name, branching* b) {
+  const char* names[] = {"row", "constrained", "wdeg"};
+  for (int k = 0; k < 3; k++) {
+    if (strcmp(name, names[k]) == 0) {
+      *b = k;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Outcome of a puzzle of a batch. */
+typedef struct {
+  const char* result;  // solved, unsat, timeout or error
+  uint nb_solutions;   // only known when solved or unsat
+  double time;  // of the load, the solve and the count, in seconds
+} batch_result;
+
+/* Puzzles of a batch: the games of a pack, or the files of a directory. */
+typedef struct {
+  game_pack pack;  // or NULL
+  char** files;
+  size_t nb_puzzles;
+  const solve_opts* opts;
+  batch_result* results;
+  pthread_mutex_t lock;
+  size_t next;  // first puzzle not yet taken by a thread
+} batch;
+
+double batch_clock(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* Loads, solves and counts puzzle k. The solutions are only counted once the
+search has found one within its budgets: a puzzle that timed out is not
+searched again without them. */
+void batch_run(batch* b, size_t k) {
+  batch_result* r = &b->results[k];
+  double start = batch_clock();
+  game g;
+  if (b->pack != NULL)
+    g = game_pack_get(b->pack, k);
+  else if (file_has_extension(b->files[k], ".mosb"))
+    g = game_load_binary(b->files[k]);
+  else
+    g = game_load(b->files[k]);
+  r->result = "error";
+  r->nb_solutions = 0;
+  if (g != NULL) {
+    const char* results[] = {[SOLVED] = "solved", [UNSAT] = "unsat",
+                             [TIMEOUT] = "timeout"};
+    solve_status status = game_solve_ext(g, b->opts, NULL);
+    r->result = results[status];
+    if (status == SOLVED) r->nb_solutions = game_nb_solutions(g);
+    game_delete(g);
+  }
+  r->time = batch_clock() - start;
+}
+
+/* Takes the puzzles one at a time until there are none left: the slow ones
+do not hold back the others. */
+void* batch_work(void* ctx) {
+  batch* b = ctx;
+  while (true) {
+    pthread_mutex_lock(&b->lock);
+    size_t k = b->next++;
+    pthread_mutex_unlock(&b->lock);
+    if (k >= b->nb_puzzles) return NULL;
+    batch_run(b, k);
+  }
+}
+
+/* game_solve --batch <dir|pack> [--threads N] [--timeout S] [--nodes N]
+[--out results.csv]: solves and counts every puzzle, each search within the
+budgets given, and writes one line per puzzle. */
+int batch_main(int argc, char* argv[], const solve_opts* opts) {
+  const char* input = argv[2];
+  const char* out_name = NULL;
+  long nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  solve_opts budgets = *opts;
+  for (int a = 3; a < argc; a += 2) {
+    if (a + 1 < argc && strcmp(argv[a], "--threads") == 0) {
+      nb_threads = strtol(argv[a + 1], NULL, 10);
+    } else if (a + 1 < argc && strcmp(argv[a], "--timeout") == 0) {
+      budgets.time_limit = strtod(argv[a + 1], NULL);
+    } else if (a + 1 < argc && strcmp(argv[a], "--nodes") == 0) {
+      budgets.node_limit = strtoul(argv[a + 1], NULL, 10);
+    } else if (a + 1 < argc && strcmp(argv[a], "--out") == 0) {
+      out_name = argv[a + 1];
+    } else {
+      fprintf(stderr, "Unknown option : %s\n", argv[a]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (nb_threads < 1) nb_threads = 1;
+
+  batch b = {NULL, NULL, 0, &budgets, NULL};
+  struct stat st;
+  if (stat(input, &st) == 0 && S_ISDIR(st.st_mode)) {
+    b.files = file_list_games(input, &b.nb_puzzles);
+    if (b.files == NULL) return EXIT_FAILURE;
+  } else {
+    b.pack = game_pack_open(input);
+    if (b.pack == NULL) return EXIT_FAILURE;
+    b.nb_puzzles = game_pack_count(b.pack);
+  }
+  FILE* out = out_name != NULL ? fopen(out_name, "w") : stdout;
+  if (out == NULL) {
+    fprintf(stderr, "Cannot open %s\n", out_name);
+    return EXIT_FAILURE;
+  }
+  // One more, for an empty batch.
+  b.results = malloc((b.nb_puzzles + 1) * sizeof(batch_result));
+  if (b.results == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+
+  double start = batch_clock();
+  pthread_mutex_init(&b.lock, NULL);
+  b.next = 0;
+  pthread_t* threads = malloc(nb_threads * sizeof(pthread_t));
+  if (threads == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  long nb_started = 0;
+  while (nb_started < nb_threads &&
+         pthread_create(&threads[nb_started], NULL, batch_work, &b) == 0)
+    nb_started++;
+  // Without any thread, the puzzles are solved here.
+  if (nb_started == 0) batch_work(&b);
+  for (long t = 0; t < nb_started; t++) pthread_join(threads[t], NULL);
+  free(threads);
+  pthread_mutex_destroy(&b.lock);
+  double elapsed = batch_clock() - start;
+
+  size_t nb_solved = 0, nb_errors = 0;
+  fprintf(out, "puzzle,result,solutions,time\n");
+  for (size_t k = 0; k < b.nb_puzzles; k++) {
+    batch_result* r = &b.results[k];
+    if (b.pack != NULL)
+      fprintf(out, "%zu", k);
+    else
+      fprintf(out, "%s", b.files[k]);
+    fprintf(out, ",%s,", r->result);
+    if (strcmp(r->result, "solved") == 0 || strcmp(r->result, "unsat") == 0)
+      fprintf(out, "%u", r->nb_solutions);
+    fprintf(out, ",%.6f\n", r->time);
+    nb_solved += strcmp(r->result, "solved") == 0;
+    nb_errors += strcmp(r->result, "error") == 0;
+  }
+  if (out != stdout) fclose(out);
+  fprintf(stderr,
+          "%zu puzzles (%zu solved, %zu errors) in %.3f s with %ld threads: "
+          "%.1f puzzles/s\n",
+          b.nb_puzzles, nb_solved, nb_errors, elapsed, nb_started,
+          elapsed > 0 ? b.nb_puzzles / elapsed : 0.0);
+
+  if (b.pack != NULL) game_pack_close(b.pack);
+  if (b.files != NULL) file_list_free(b.files, b.nb_puzzles);
+  free(b.results);
+  return nb_errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void usage(void) {
+  printf(
+      "Syntax : ./game_solve [--branching <heuristic>] <option> <input> "
+      "[<output>]\n");
+  printf("Possible inputs : -s, -S, -c, -u, -a, -d <output>\n");
+  printf(
+      "Batch : ./game_solve [--branching <heuristic>] --batch <dir|pack> "
+      "[--threads N] [--timeout S] [--nodes N] [--out results.csv]\n");
+}
+
 int main(int argc, char* argv[]) {
+  // --branching <row|constrained|wdeg> comes before the option, for -s.
+  solve_opts opts = {BRANCH_ROW_MAJOR};
+  if (argc >= 3 && strcmp(argv[1], "--branching") == 0) {
+    if (!parse_branching(argv[2], &opts.branching)) {
+      printf("Unknown branching : %s (row, constrained or wdeg)\n", argv[2]);
+      return EXIT_FAILURE;
+    }
+    argc -= 2;
+    argv += 2;
+  }
   if (argc <= 2) {
-    printf("Syntax : ./game_solve <option> <input> [<output>]\n");
-    printf("Possible inputs : -s, -c\n");
+    usage();
     return EXIT_FAILURE;
   }
+  if (strcmp(argv[1], "--batch") == 0) return batch_main(argc, argv, &opts);
   char* arg = argv[1];
   game g = game_load(argv[2]);
-  if (strcmp(arg, "-s") == 0) {
-    if (game_solve(g)) {
+  if (g == NULL) return EXIT_FAILURE;
+  if (strcmp(arg, "-s") == 0 || strcmp(arg, "-S") == 0) {
+    // -S solves with the SAT solver rather than the search
+    bool found = strcmp(arg, "-S") == 0 ? game_solve_sat(g)
+                                        : game_solve_opts(g, &opts);
+    if (found) {
       if (argc == 4) {
         game_save(g, argv[3]);
       } else {
@@ -29,22 +250,53 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
   if (strcmp(arg, "-c") == 0) {
-    int n_solutions = game_nb_solutions(g);
+    uint n_solutions = game_nb_solutions(g);
 
     if (argc == 4) {
       FILE* fp = fopen(argv[3], "w");
       if (n_solutions != 0) {
-        fprintf(fp, "%d", n_solutions);
+        fprintf(fp, "%u", n_solutions);
       }
       fclose(fp);
     } else {
-      printf("Number of solutions: %d\n", n_solutions);
+      printf("Number of solutions: %u\n", n_solutions);
     }
     game_delete(g);
     return EXIT_SUCCESS;
+  }
+  if (strcmp(arg, "-u") == 0) {
+    // Zero, one, or more than one solution.
+    uint n_solutions = game_nb_solutions_upto(g, 2);
+    if (n_solutions == 1) {
+      printf("Unique solution\n");
+    } else if (n_solutions == 0) {
+      printf("No solution\n");
+    } else {
+      printf("Several solutions\n");
+    }
+    game_delete(g);
+    return EXIT_SUCCESS;
+  }
+  if (strcmp(arg, "-a") == 0) {
+    // Every solution, written as soon as it is found.
+    solution_writer w = {stdout, game_nb_rows(g), game_nb_cols(g)};
+    if (argc == 4) w.out = fopen(argv[3], "w");
+    if (w.out == NULL) {
+      fprintf(stderr, "Cannot open %s\n", argv[3]);
+      game_delete(g);
+      return EXIT_FAILURE;
+    }
+    game_foreach_solution(g, write_solution, &w);
+    if (argc == 4) fclose(w.out);
+    game_delete(g);
+    return EXIT_SUCCESS;
+  }
+  if (strcmp(arg, "-d") == 0 && argc == 4) {
+    game_save_cnf(g, argv[3]);
+    game_delete(g);
+    return EXIT_SUCCESS;
   } else {
-    printf("Syntax : ./game_solve <option> <input> [<output>]\n");
-    printf("Possible inputs : -s, -c");
+    usage();
     game_delete(g);
     return EXIT_FAILURE;
   }
@@ -0,0 +1,125 @@
+// clock_gettime and getrusage
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "game.h"
+#include "game_ext.h"
+#include "game_tools.h"
+
+#define NB_MOVES 1000000
+
+/* Seconds elapsed since start. */
+double elapsed(const struct timespec* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+/* Prints the time taken by a step and restarts the clock. */
+void step(const char* name, struct timespec* start) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("%-32s %8.3fs %8ld MB\n", name, elapsed(start),
+         usage.ru_maxrss / 1024);
+  fflush(stdout);
+  clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+void usage(char* argv[]) {
+  fprintf(stderr, "Usage: %s [<nb_rows> <nb_cols> [solve]]\n", argv[0]);
+  exit(EXIT_FAILURE);
+}
+
+/* Runs the game functions on a large random game and prints their time and the
+memory used so far: 10000x10000 squares by default. The game is saved to
+game_stress.txt in the current directory, which is then removed. With solve,
+the game is also solved and counted from its constraints alone. */
+int main(int argc, char* argv[]) {
+  uint nb_rows = 10000, nb_cols = 10000;
+  bool solve = false;
+  if (argc >= 3) {
+    nb_rows = strtoul(argv[1], NULL, 10);
+    nb_cols = strtoul(argv[2], NULL, 10);
+    solve = argc == 4 && strcmp(argv[3], "solve") == 0;
+    if (nb_rows == 0 || nb_cols == 0 || argc > 4 || (argc == 4 && !solve))
+      usage(argv);
+  } else if (argc != 1) {
+    usage(argv);
+  }
+  printf("%u x %u = %zu squares\n", nb_rows, nb_cols,
+         (size_t)nb_rows * nb_cols);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  srand(1);
+
+  game g = game_new_empty_ext(nb_rows, nb_cols, false, FULL);
+  step("game_new_empty_ext", &start);
+  for (uint i = 0; i < nb_rows; i++)
+    for (uint j = 0; j < nb_cols; j++)
+      game_set_color(g, i, j, rand() % 2 ? BLACK : WHITE);
+  step("game_set_color (every square)", &start);
+  for (uint i = 0; i < nb_rows; i++)
+    for (uint j = 0; j < nb_cols; j++)
+      game_set_constraint(g, i, j, game_nb_neighbors(g, i, j, BLACK));
+  step("game_set_constraint (every one)", &start);
+  if (!game_won(g)) {
+    fprintf(stderr, "The game built from its solution is not won\n");
+    return EXIT_FAILURE;
+  }
+  step("game_won", &start);
+
+  status* map = malloc((size_t)nb_rows * nb_cols * sizeof(status));
+  if (map == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  game_get_status_map(g, map);
+  free(map);
+  step("game_get_status_map", &start);
+
+  for (uint m = 0; m < NB_MOVES; m++) {
+    uint i = rand() % nb_rows, j = rand() % nb_cols;
+    game_play_move(g, i, j, EMPTY);
+    if (game_won(g) || game_get_status(g, i, j) == SATISFIED) {
+      fprintf(stderr, "A game with an empty square is won\n");
+      return EXIT_FAILURE;
+    }
+    game_undo(g);
+  }
+  if (!game_won(g)) {
+    fprintf(stderr, "The moves were not all undone\n");
+    return EXIT_FAILURE;
+  }
+  step("game_play_move + game_undo (1M)", &start);
+
+  game_save(g, "game_stress.txt");
+  step("game_save", &start);
+  game g2 = game_load("game_stress.txt");
+  remove("game_stress.txt");
+  step("game_load", &start);
+  if (g2 == NULL || !game_equal(g, g2)) {
+    fprintf(stderr, "The game loaded differs from the game saved\n");
+    return EXIT_FAILURE;
+  }
+  game_delete(g2);
+  step("game_equal", &start);
+
+  if (solve) {
+    game_restart(g);
+    if (!game_solve(g) || !game_won(g)) {
+      fprintf(stderr, "The game was not solved\n");
+      return EXIT_FAILURE;
+    }
+    step("game_solve", &start);
+    uint nb_solutions = game_nb_solutions(g);
+    printf("%u solution(s)\n", nb_solutions);
+    step("game_nb_solutions", &start);
+  }
+  game_delete(g);
+  return EXIT_SUCCESS;
+}
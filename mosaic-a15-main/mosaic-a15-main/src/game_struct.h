@@ -1,15 +1,66 @@
 #ifndef __STRUCT_H__
 #define __STRUCT_H__
+#include <stddef.h>
+#include <stdint.h>
+
 #include "game_ext.h"
 #include "queue.h"
 struct game_s {
-  int height;
-  int width;
-  constraint *constraints;
-  color *colors;
+  uint height;
+  uint width;
+  // one byte per square: its color in bits 0-1 and its constraint plus one in
+  // bits 2-7, see the cell_ functions below
+  uint8_t *cells;
   neighbourhood neighbourhood;
   bool wrapping;
   queue *prv_moves;
   queue *undone_moves;
+  // bit planes of the colors, see game_bitboard.h
+  uint words;
+  uint64_t *black;
+  uint64_t *decided;
+  // kernels of the neighbourhood and the wrapping, see game_kernels.h
+  const struct game_ops *ops;
+  // neighbourhoods of the squares in CSR form, built on the copies of the
+  // solver, NULL otherwise: those of square k are
+  // neighbours[neighbours_start[k] .. neighbours_start[k+1]-1]
+  uint *neighbours_start;
+  uint *neighbours;
+  // number of BLACK and EMPTY squares in the neighbourhood of each square,
+  // number of EMPTY squares and of squares whose status is not SATISFIED: kept
+  // by game_set_color and game_set_constraint, not by the solver which colors
+  // its own copies through game_bitboard.h
+  // the two counts of square k share windows[k]: BLACK in bits 0-3, EMPTY in
+  // bits 4-7
+  uint8_t *windows;
+  size_t nb_empty;
+  size_t nb_unsatisfied;
 };
+
+/* Rebuilds the bit planes and the neighbourhood counts of g from its cells,
+once they were written directly, without game_set_color and
+game_set_constraint. */
+void game_sync(struct game_s *g);
+
+// Largest constraint that fits in a cell, well above the 9 squares of a
+// neighbourhood.
+#define CELL_MAX_CONSTRAINT 62
+
+static inline color cell_color(const struct game_s *g, size_t k) {
+  return (color)(g->cells[k] & 3);
+}
+
+static inline constraint cell_constraint(const struct game_s *g, size_t k) {
+  return (constraint)(g->cells[k] >> 2) - 1;
+}
+
+static inline void cell_set_color(struct game_s *g, size_t k, color c) {
+  g->cells[k] = (g->cells[k] & ~3) | c;
+}
+
+static inline void cell_set_constraint(struct game_s *g, size_t k,
+                                       constraint n) {
+  if (n > CELL_MAX_CONSTRAINT) n = CELL_MAX_CONSTRAINT;
+  g->cells[k] = (g->cells[k] & 3) | (uint8_t)((n + 1) << 2);
+}
 #endif
@@ -0,0 +1,134 @@
+#include "game_sums.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "game_bitboard.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+void window_sums_init(window_sums* s, cgame g) {
+  s->g = g;
+  s->length = 64 * g->words;
+  // 3 rows of black and empty lines, and the zero line.
+  s->lines = calloc(7 * s->length, 1);
+  s->vsums = malloc(6 * s->length);
+  if (s->lines == NULL || s->vsums == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  window_sums_reset(s);
+}
+
+void window_sums_free(window_sums* s) {
+  free(s->lines);
+  free(s->vsums);
+}
+
+void window_sums_reset(window_sums* s) {
+  for (int k = 0; k < 3; k++) s->rows[k] = -1;
+}
+
+/* out[j] = a[j] + b[j] + c[j] for j < n. */
+static void add3(uint8_t* out, const uint8_t* a, const uint8_t* b,
+                 const uint8_t* c, uint n) {
+  uint j = 0;
+#ifdef __AVX2__
+  for (; j + 32 <= n; j += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(a + j));
+    __m256i y = _mm256_loadu_si256((const __m256i*)(b + j));
+    __m256i z = _mm256_loadu_si256((const __m256i*)(c + j));
+    x = _mm256_add_epi8(_mm256_add_epi8(x, y), z);
+    _mm256_storeu_si256((__m256i*)(out + j), x);
+  }
+#endif
+#ifdef __SSE2__
+  for (; j + 16 <= n; j += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(a + j));
+    __m128i y = _mm_loadu_si128((const __m128i*)(b + j));
+    __m128i z = _mm_loadu_si128((const __m128i*)(c + j));
+    x = _mm_add_epi8(_mm_add_epi8(x, y), z);
+    _mm_storeu_si128((__m128i*)(out + j), x);
+  }
+#endif
+  for (; j < n; j++) out[j] = a[j] + b[j] + c[j];
+}
+
+/* Spreads the 64 bits of w to the bytes line[0..63], bit k to line[k]. */
+static void spread(uint8_t* line, uint64_t w) {
+  for (int b = 0; b < 8; b++) {
+    uint64_t x = (w >> (8 * b)) & 0xFF;
+    // Bit k of x goes to bit 8k.
+    x = (x | x << 28) & 0x0000000F0000000Fu;
+    x = (x | x << 14) & 0x0003000300030003u;
+    x = (x | x << 7) & 0x0101010101010101u;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(line + 8 * b, &x, 8);
+#else
+    for (int k = 0; k < 8; k++) line[8 * b + k] = (x >> (8 * k)) & 1;
+#endif
+  }
+}
+
+/* Slot of lines holding row rows[r] of the grid, which is spread if needed
+into a slot that holds none of rows. The black line of slot k is line 2k, the
+empty line 2k + 1. */
+static int spread_row(window_sums* s, const int rows[3], int r) {
+  int i = rows[r];
+  for (int k = 0; k < 3; k++) {
+    if (s->rows[k] == i) return k;
+  }
+  int k = 0;
+  while (s->rows[k] >= 0 &&
+         (s->rows[k] == rows[0] || s->rows[k] == rows[1] ||
+          s->rows[k] == rows[2]))
+    k++;
+  cgame g = s->g;
+  const uint64_t* black = bb_row(g->black, g, i);
+  const uint64_t* decided = bb_row(g->decided, g, i);
+  for (uint w = 0; w < g->words; w++) {
+    // The padding columns are squares of the grid only when wrapping.
+    uint64_t inside = bb_squares_mask(g, w);
+    if (g->wrapping && w == 0) inside |= 1;
+    if (g->wrapping && w == (g->width + 1) >> 6)
+      inside |= (uint64_t)1 << ((g->width + 1) & 63);
+    spread(s->lines + (2 * k) * s->length + 64 * w, black[w]);
+    spread(s->lines + (2 * k + 1) * s->length + 64 * w, inside & ~decided[w]);
+  }
+  s->rows[k] = i;
+  return k;
+}
+
+void window_sums_row(window_sums* s, uint i, uint8_t black[], uint8_t empty[]) {
+  cgame g = s->g;
+  const uint* masks = bb_masks[g->neighbourhood];
+  int rows[3], cols[3];
+  bb_window_lines(g, i, 0, rows, cols);
+  // Slots of the rows above, at and below i; 3 is the zero line.
+  int slots[3];
+  for (int r = 0; r < 3; r++) slots[r] = rows[r] >= 0 ? -1 : 3;
+  for (int r = 0; r < 3; r++) {
+    if (slots[r] < 0) slots[r] = spread_row(s, rows, r);
+  }
+  const uint8_t* zero = s->lines + 6 * s->length;
+  uint n = g->width + 2;
+  for (int p = 0; p < 2; p++) {
+    // Column sums: columns[c] adds the rows that column c of the window uses.
+    uint8_t* columns[3];
+    for (int c = 0; c < 3; c++) {
+      const uint8_t* in[3];
+      for (int r = 0; r < 3; r++) {
+        bool used = (masks[r] >> c) & 1 && slots[r] < 3;
+        in[r] = used ? s->lines + (2 * slots[r] + p) * s->length : zero;
+      }
+      columns[c] = s->vsums + (3 * p + c) * s->length;
+      add3(columns[c], in[0], in[1], in[2], n);
+    }
+    // Square j is byte j + 1 of a line: its window is bytes j to j + 2.
+    add3(p == 0 ? black : empty, columns[0], columns[1] + 1, columns[2] + 2,
+         g->width);
+  }
+}
@@ -0,0 +1,44 @@
+/**
+ * @file game_sums.h
+ * @brief Black and empty counts of every neighbourhood of a row (internal).
+ * @details The bit planes of a row (see game_bitboard.h) are spread to one byte
+ * per square, padding columns included, which is the halo of the row: it holds
+ * zeros, or a copy of the opposite edge when the game is wrapping. The rows
+ * above and below the grid are zero rows, or again copies when wrapping. The
+ * counts of a whole row of neighbourhoods are then two passes of byte
+ * additions: the three rows are added column by column, as selected by the
+ * neighbourhood, then the three columns of each window. The additions work on
+ * 32 (AVX2) or 16 (SSE2) bytes at a time when the compiler targets them.
+ **/
+
+#ifndef __GAME_SUMS_H__
+#define __GAME_SUMS_H__
+
+#include <stdint.h>
+
+#include "game_struct.h"
+
+/** Rows of a game spread to bytes, as needed to count its neighbourhoods. */
+typedef struct {
+  cgame g;
+  uint length;      // of a line: the row and its padding, rounded to 64
+  uint8_t* lines;   // black and empty lines of 3 rows, then a zero line
+  int rows[3];      // row held by each slot of lines, or -1
+  uint8_t* vsums;   // the 3 column sums of the black and empty lines
+} window_sums;
+
+/** Prepares the counts of the neighbourhoods of g. */
+void window_sums_init(window_sums* s, cgame g);
+
+void window_sums_free(window_sums* s);
+
+/** Fills black[j] and empty[j] with the number of BLACK and EMPTY squares of
+ * the neighbourhood of (i,j), for every column j. The rows are spread when
+ * first needed and then kept while the next rows are counted: once the colors
+ * of g change, window_sums_reset must be called. */
+void window_sums_row(window_sums* s, uint i, uint8_t black[], uint8_t empty[]);
+
+/** Forgets the rows spread so far. */
+void window_sums_reset(window_sums* s);
+
+#endif  // __GAME_SUMS_H__
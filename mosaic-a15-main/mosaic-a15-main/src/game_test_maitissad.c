@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,6 +7,8 @@
 #include "game.h"
 #include "game_aux.h"
 #include "game_ext.h"
+#include "game_pack.h"
+#include "game_tools.h"
 
 #define ASSERT(expr)                                                          \
   do {                                                                        \
@@ -273,6 +276,47 @@ bool test_game_get_status(void) {
   game_set_color(g, 0, 1, BLACK);
   ASSERT(game_get_status(g, 0, 0) == ERROR);
   game_delete(g);
+
+  // The counts kept by the game follow moves, undos, redos, restarts and new
+  // constraints: compare them with a recount of each neighbourhood, on every
+  // neighbourhood, wrapping or not, including grids too narrow for a window.
+  for (int k = 0; k < 8; k++) {
+    uint nb_rows = 1 + rand() % 5, nb_cols = 1 + rand() % 5;
+    game g2 = game_new_empty_ext(nb_rows, nb_cols, k % 2, k / 2);
+    for (int move = 0; move < 200; move++) {
+      uint i = rand() % nb_rows, j = rand() % nb_cols;
+      int r = rand() % 10;
+      if (r < 5)
+        game_play_move(g2, i, j, rand() % 3);
+      else if (r < 7)
+        game_undo(g2);
+      else if (r < 8)
+        game_redo(g2);
+      else if (r < 9)
+        game_set_constraint(g2, i, j, rand() % 11 - 1);
+      else if (rand() % 10 == 0)
+        game_restart(g2);
+      bool won = true;
+      for (uint a = 0; a < nb_rows; a++)
+        for (uint b = 0; b < nb_cols; b++) {
+          int nb_black = game_nb_neighbors(g2, a, b, BLACK);
+          int nb_empty = game_nb_neighbors(g2, a, b, EMPTY);
+          int n = game_get_constraint(g2, a, b);
+          status st = UNSATISFIED;
+          if (n == UNCONSTRAINED) {
+            if (nb_empty == 0) st = SATISFIED;
+          } else if (nb_black > n || nb_empty < n - nb_black) {
+            st = ERROR;
+          } else if (nb_black == n && nb_empty == 0) {
+            st = SATISFIED;
+          }
+          ASSERT(game_get_status(g2, a, b) == st);
+          won &= st == SATISFIED && game_get_color(g2, a, b) != EMPTY;
+        }
+      ASSERT(game_won(g2) == won);
+    }
+    game_delete(g2);
+  }
   return true;
 }
 
@@ -339,6 +383,735 @@ bool test_game_play_move() {
   return true;
 }
 
+// Builds a game whose constraints are computed from a random coloring, so that
+// it has at least one solution.
+game random_solvable_game(uint nb_rows, uint nb_cols, bool wrapping,
+                          neighbourhood n) {
+  game sol = game_new_empty_ext(nb_rows, nb_cols, wrapping, n);
+  for (uint i = 0; i < nb_rows; i++)
+    for (uint j = 0; j < nb_cols; j++)
+      game_set_color(sol, i, j, rand() % 2 ? BLACK : WHITE);
+  game g = game_new_empty_ext(nb_rows, nb_cols, wrapping, n);
+  for (uint i = 0; i < nb_rows; i++)
+    for (uint j = 0; j < nb_cols; j++)
+      if (rand() % 4 != 0)
+        game_set_constraint(g, i, j, game_nb_neighbors(sol, i, j, BLACK));
+  game_delete(sol);
+  return g;
+}
+
+bool test_game_get_status_map() {
+  // Every neighbourhood, with and without wrapping, on grids narrow enough for
+  // a square to be its own neighbour, and on rows longer than a word.
+  uint sizes[] = {1, 2, 3, 4, 5, 63, 64, 65, 130};
+  for (uint a = 0; a < 9; a++)
+    for (uint b = 0; b < 5; b++)
+      for (int k = 0; k < 8; k++) {
+        uint nb_rows = a < 5 ? sizes[a] : sizes[b];
+        uint nb_cols = sizes[a];
+        game g = game_new_empty_ext(nb_rows, nb_cols, k % 2, k / 2);
+        for (uint i = 0; i < nb_rows; i++)
+          for (uint j = 0; j < nb_cols; j++) {
+            game_set_color(g, i, j, rand() % 3);
+            game_set_constraint(g, i, j, rand() % 11 - 1);
+          }
+        status* map = malloc(nb_rows * nb_cols * sizeof(status));
+        ASSERT(map);
+        game_get_status_map(g, map);
+        for (uint i = 0; i < nb_rows; i++)
+          for (uint j = 0; j < nb_cols; j++)
+            ASSERT(map[i * nb_cols + j] == game_get_status(g, i, j));
+        free(map);
+        game_delete(g);
+      }
+  return true;
+}
+
+bool test_game_solve() {
+  game g1 = game_default();
+  ASSERT(g1);
+  game g2 = game_default_solution();
+  ASSERT(g2);
+  game_play_move(g1, 0, 0, BLACK);  // the colors already played are ignored
+  ASSERT(game_solve(g1));
+  ASSERT(game_equal(g1, g2));  // the default game has a unique solution
+
+  // A game without solution must be left unchanged.
+  game g3 = game_new_empty_ext(3, 3, false, FULL);
+  game_set_constraint(g3, 0, 0, 9);  // a corner only has 4 neighbours
+  game_set_color(g3, 1, 1, WHITE);
+  game g4 = game_copy(g3);
+  ASSERT(!game_solve(g3));
+  ASSERT(game_equal(g3, g4));
+
+  // Every neighbourhood, with and without wrapping.
+  for (int k = 0; k < 8; k++) {
+    game g = random_solvable_game(6, 7, k % 2, k / 2);
+    ASSERT(game_solve(g));
+    ASSERT(game_won(g));
+    game_delete(g);
+  }
+
+  game_delete(g1);
+  game_delete(g2);
+  game_delete(g3);
+  game_delete(g4);
+  return true;
+}
+
+bool test_game_solve_opts() {
+  for (branching b = BRANCH_ROW_MAJOR; b <= BRANCH_WDEG; b++) {
+    solve_opts opts = {b};
+    game g1 = game_default();
+    ASSERT(g1);
+    game g2 = game_default_solution();
+    ASSERT(g2);
+    ASSERT(game_solve_opts(g1, &opts));
+    ASSERT(game_equal(g1, g2));
+
+    // A game without solution must be left unchanged.
+    game g3 = game_new_empty_ext(3, 3, false, FULL);
+    game_set_constraint(g3, 0, 0, 9);
+    game g4 = game_copy(g3);
+    ASSERT(!game_solve_opts(g3, &opts));
+    ASSERT(game_equal(g3, g4));
+
+    for (int k = 0; k < 8; k++) {
+      game g = random_solvable_game(6, 7, k % 2, k / 2);
+      ASSERT(game_solve_opts(g, &opts));
+      ASSERT(game_won(g));
+      game_delete(g);
+    }
+    game_delete(g1);
+    game_delete(g2);
+    game_delete(g3);
+    game_delete(g4);
+  }
+  return true;
+}
+
+bool test_game_solve_ext() {
+  solve_opts opts = {BRANCH_ROW_MAJOR, 0, 0, NULL};
+  solve_result r;
+  game g1 = game_default();
+  ASSERT(g1);
+  game g2 = game_default_solution();
+  ASSERT(g2);
+  ASSERT(game_solve_ext(g1, &opts, &r) == SOLVED);
+  ASSERT(r.status == SOLVED);
+  ASSERT(game_equal(g1, g2));
+
+  game g3 = game_new_empty_ext(3, 3, false, FULL);
+  game_set_constraint(g3, 0, 0, 9);
+  game g4 = game_copy(g3);
+  ASSERT(game_solve_ext(g3, &opts, NULL) == UNSAT);
+  ASSERT(game_equal(g3, g4));
+
+  // Every square of an empty game needs a decision: the budgets run out first,
+  // and the game is left unchanged.
+  game g5 = game_new_empty_ext(5, 5, false, FULL);
+  game_set_color(g5, 2, 2, BLACK);
+  game g6 = game_copy(g5);
+  opts.node_limit = 3;
+  ASSERT(game_solve_ext(g5, &opts, &r) == TIMEOUT);
+  ASSERT(r.status == TIMEOUT && r.nb_nodes == 3);
+  ASSERT(game_equal(g5, g6));
+  opts.node_limit = 0;
+  opts.time_limit = 1e-9;
+  ASSERT(game_solve_ext(g5, &opts, NULL) == TIMEOUT);
+  ASSERT(game_equal(g5, g6));
+  opts.time_limit = 0;
+  volatile bool cancel = true;
+  opts.cancel = &cancel;
+  ASSERT(game_solve_ext(g5, &opts, NULL) == TIMEOUT);
+  ASSERT(game_equal(g5, g6));
+  cancel = false;
+  ASSERT(game_solve_ext(g5, &opts, &r) == SOLVED);
+  ASSERT(r.nb_nodes == 25);
+  ASSERT(game_won(g5));
+
+  game_delete(g1);
+  game_delete(g2);
+  game_delete(g3);
+  game_delete(g4);
+  game_delete(g5);
+  game_delete(g6);
+  return true;
+}
+
+bool test_game_solve_sat() {
+  game g1 = game_default();
+  ASSERT(g1);
+  game g2 = game_default_solution();
+  ASSERT(g2);
+  game_play_move(g1, 0, 0, BLACK);  // the colors already played are ignored
+  ASSERT(game_solve_sat(g1));
+  ASSERT(game_equal(g1, g2));  // the default game has a unique solution
+
+  // A game without solution must be left unchanged.
+  game g3 = game_new_empty_ext(3, 3, false, FULL);
+  game_set_constraint(g3, 0, 0, 9);
+  game_set_color(g3, 1, 1, WHITE);
+  game g4 = game_copy(g3);
+  ASSERT(!game_solve_sat(g3));
+  ASSERT(game_equal(g3, g4));
+
+  // Every neighbourhood, with and without wrapping, including grids narrow
+  // enough for a square to be counted several times.
+  for (int k = 0; k < 8; k++) {
+    for (uint nb_cols = 1; nb_cols <= 7; nb_cols += 3) {
+      game g = random_solvable_game(6, nb_cols, k % 2, k / 2);
+      ASSERT(game_solve_sat(g));
+      ASSERT(game_won(g));
+      game_delete(g);
+    }
+  }
+  // Same answer as game_solve on games that may have no solution.
+  for (int k = 0; k < 40; k++) {
+    game g = random_solvable_game(4, 5, k % 2, k % 4);
+    game_set_constraint(g, k % 4, k % 5, k % 10);
+    game g5 = game_copy(g);
+    ASSERT(game_solve_sat(g) == game_solve(g5));
+    game_delete(g);
+    game_delete(g5);
+  }
+
+  game_delete(g1);
+  game_delete(g2);
+  game_delete(g3);
+  game_delete(g4);
+  return true;
+}
+
+bool test_game_save_cnf() {
+  game g = game_default();
+  ASSERT(g);
+  game_save_cnf(g, "default.cnf");
+  FILE* f = fopen("default.cnf", "r");
+  ASSERT(f);
+  // The comment line, then the header.
+  int c;
+  while ((c = fgetc(f)) != '\n') ASSERT(c != EOF);
+  int nb_vars, nb_clauses;
+  ASSERT(fscanf(f, "p cnf %d %d", &nb_vars, &nb_clauses) == 2);
+  ASSERT(nb_vars > DEFAULT_SIZE * DEFAULT_SIZE);
+  // Every clause is ended by a 0 and only uses declared variables.
+  int lit, nb_read = 0;
+  while (fscanf(f, "%d", &lit) == 1) {
+    ASSERT(abs(lit) <= nb_vars);
+    if (lit == 0) nb_read++;
+  }
+  ASSERT(nb_read == nb_clauses);
+  fclose(f);
+  remove("default.cnf");
+  game_delete(g);
+  return true;
+}
+
+bool test_game_save_binary() {
+  // Every neighbourhood, wrapping or not, with odd numbers of squares so that
+  // the last byte of the constraints and of the colors is partly used.
+  for (int k = 0; k < 8; k++) {
+    uint nb_rows = 1 + rand() % 7, nb_cols = 1 + rand() % 70;
+    game g = game_new_empty_ext(nb_rows, nb_cols, k % 2, k / 2);
+    for (uint i = 0; i < nb_rows; i++)
+      for (uint j = 0; j < nb_cols; j++) {
+        game_set_color(g, i, j, rand() % 3);
+        game_set_constraint(g, i, j, rand() % 11 - 1);
+      }
+    game_save_binary(g, "save_binary.mosb");
+    FILE* f = fopen("save_binary.mosb", "rb");
+    ASSERT(f);
+    fseek(f, 0, SEEK_END);
+    uint nb_squares = nb_rows * nb_cols;
+    ASSERT(ftell(f) == 16 + (nb_squares + 1) / 2 + (nb_squares + 3) / 4);
+    fclose(f);
+    game g2 = game_load_binary("save_binary.mosb");
+    ASSERT(g2);
+    ASSERT(game_equal(g, g2));
+    for (uint i = 0; i < nb_rows; i++)
+      for (uint j = 0; j < nb_cols; j++)
+        ASSERT(game_get_status(g, i, j) == game_get_status(g2, i, j));
+    ASSERT(game_won(g) == game_won(g2));
+    game_delete(g);
+    game_delete(g2);
+  }
+  // The saved solution is still won once loaded.
+  game g = game_default_solution();
+  game_save_binary(g, "save_binary.mosb");
+  game g2 = game_load_binary("save_binary.mosb");
+  ASSERT(g2);
+  ASSERT(game_won(g2));
+  game_delete(g);
+  game_delete(g2);
+  remove("save_binary.mosb");
+  return true;
+}
+
+/* Writes size bytes to a file. */
+bool write_bytes(const char* filename, const unsigned char* bytes, int size) {
+  FILE* f = fopen(filename, "wb");
+  if (f == NULL) return false;
+  bool ok = fwrite(bytes, 1, size, f) == size;
+  fclose(f);
+  return ok;
+}
+
+bool test_game_load_binary() {
+  // A 1x3 wrapping ORTHO game: constraints 2, none, 0 and colors black, empty,
+  // white.
+  unsigned char bytes[] = {'M', 'O', 'S', 'B', 1, 1, ORTHO, 0, 1, 0, 0, 0,
+                           3,   0,   0,   0,   0x03, 0x01, 0x12};
+  ASSERT(write_bytes("load_binary.mosb", bytes, sizeof(bytes)));
+  game g = game_load_binary("load_binary.mosb");
+  ASSERT(g);
+  ASSERT(game_nb_rows(g) == 1 && game_nb_cols(g) == 3);
+  ASSERT(game_is_wrapping(g) && game_get_neighbourhood(g) == ORTHO);
+  ASSERT(game_get_constraint(g, 0, 0) == 2);
+  ASSERT(game_get_constraint(g, 0, 1) == UNCONSTRAINED);
+  ASSERT(game_get_constraint(g, 0, 2) == 0);
+  ASSERT(game_get_color(g, 0, 0) == BLACK);
+  ASSERT(game_get_color(g, 0, 1) == EMPTY);
+  ASSERT(game_get_color(g, 0, 2) == WHITE);
+  game_delete(g);
+
+  // Invalid files: wrong magic, unknown version, bad neighbourhood, invalid
+  // color, truncated and missing.
+  int offsets[] = {0, 4, 6, 18};
+  unsigned char values[] = {'m', 2, 4, 0x32};
+  for (int t = 0; t < 4; t++) {
+    unsigned char bad[sizeof(bytes)];
+    memcpy(bad, bytes, sizeof(bytes));
+    bad[offsets[t]] = values[t];
+    ASSERT(write_bytes("load_binary.mosb", bad, sizeof(bad)));
+    ASSERT(game_load_binary("load_binary.mosb") == NULL);
+  }
+  ASSERT(write_bytes("load_binary.mosb", bytes, sizeof(bytes) - 1));
+  ASSERT(game_load_binary("load_binary.mosb") == NULL);
+  remove("load_binary.mosb");
+  ASSERT(game_load_binary("load_binary.mosb") == NULL);
+  return true;
+}
+
+bool test_game_load() {
+  // A 2x3 wrapping ORTHO game, with "\r\n" and no final newline.
+  const char* text = "2 3 1 1\r\n2b-e0w\r\n-w9e-b";
+  ASSERT(write_bytes("text.txt", (const unsigned char*)text, strlen(text)));
+  game g = game_load("text.txt");
+  ASSERT(g);
+  ASSERT(game_nb_rows(g) == 2 && game_nb_cols(g) == 3);
+  ASSERT(game_is_wrapping(g) && game_get_neighbourhood(g) == ORTHO);
+  ASSERT(game_get_constraint(g, 0, 0) == 2);
+  ASSERT(game_get_constraint(g, 0, 1) == UNCONSTRAINED);
+  ASSERT(game_get_constraint(g, 1, 1) == 9);
+  ASSERT(game_get_color(g, 0, 0) == BLACK);
+  ASSERT(game_get_color(g, 0, 1) == EMPTY);
+  ASSERT(game_get_color(g, 1, 0) == WHITE);
+  ASSERT(game_get_color(g, 1, 2) == BLACK);
+  // The counts of the neighbourhoods are those of the same game played.
+  game g2 = game_new_empty_ext(2, 3, true, ORTHO);
+  for (uint i = 0; i < 2; i++) {
+    for (uint j = 0; j < 3; j++) {
+      game_set_constraint(g2, i, j, game_get_constraint(g, i, j));
+      game_set_color(g2, i, j, game_get_color(g, i, j));
+    }
+  }
+  for (uint i = 0; i < 2; i++)
+    for (uint j = 0; j < 3; j++)
+      ASSERT(game_get_status(g, i, j) == game_get_status(g2, i, j));
+  ASSERT(game_won(g) == game_won(g2));
+  game_delete(g2);
+
+  // The saved game is loaded back.
+  game_save(g, "text.txt");
+  g2 = game_load("text.txt");
+  ASSERT(g2 && game_equal(g, g2));
+  game_delete(g2);
+  game_delete(g);
+
+  // Malformed files: bad header, constraint, color, row lengths and trailing
+  // characters.
+  const char* bad[] = {"2 3 1\n2b-e0w\n-w9e-b",  "2 3 1 4\n2b-e0w\n-w9e-b",
+                       "2 3 1 1\n2b-e0x\n-w9e-b", "2 3 1 1\n2b-e#w\n-w9e-b",
+                       "2 3 1 1\n2b-e0w-e\n-w9e", "2 3 1 1\n2b-e0w\n-w9e",
+                       "2 3 1 1\n2b-e0w\n-w9e-b\nx", "0 3 1 1\n"};
+  for (uint t = 0; t < sizeof(bad) / sizeof(bad[0]); t++) {
+    ASSERT(write_bytes("text.txt", (const unsigned char*)bad[t],
+                       strlen(bad[t])));
+    ASSERT(game_load("text.txt") == NULL);
+  }
+  remove("text.txt");
+  ASSERT(game_load("text.txt") == NULL);
+  return true;
+}
+
+bool test_game_load_from_buffer() {
+  // Not null-terminated: the size alone ends the text.
+  const char text[] = {'1', ' ', '2', ' ', '0', ' ', '0', '\n',
+                       '1', 'b', '-', 'w', 'X'};
+  game g = game_load_from_buffer(text, sizeof(text) - 1);
+  ASSERT(g);
+  ASSERT(game_nb_rows(g) == 1 && game_nb_cols(g) == 2);
+  ASSERT(!game_is_wrapping(g) && game_get_neighbourhood(g) == FULL);
+  ASSERT(game_get_constraint(g, 0, 0) == 1);
+  ASSERT(game_get_constraint(g, 0, 1) == UNCONSTRAINED);
+  ASSERT(game_get_color(g, 0, 0) == BLACK);
+  ASSERT(game_get_color(g, 0, 1) == WHITE);
+  ASSERT(game_won(g));
+  game_delete(g);
+  ASSERT(game_load_from_buffer(text, sizeof(text)) == NULL);
+  ASSERT(game_load_from_buffer(text, sizeof(text) - 2) == NULL);
+  ASSERT(game_load_from_buffer(text, 0) == NULL);
+
+  // Same game as from the file.
+  game g1 = game_default();
+  game_save(g1, "load_from_buffer.txt");
+  g = game_load("load_from_buffer.txt");
+  remove("load_from_buffer.txt");
+  size_t size = game_save_to_buffer(g1, NULL, 0);
+  char* buffer = malloc(size);
+  ASSERT(buffer);
+  game_save_to_buffer(g1, buffer, size);
+  game g2 = game_load_from_buffer(buffer, size);
+  ASSERT(g && g2 && game_equal(g, g2) && game_equal(g1, g2));
+  free(buffer);
+  game_delete(g);
+  game_delete(g1);
+  game_delete(g2);
+  return true;
+}
+
+bool test_game_save_to_buffer() {
+  game g = game_new_empty_ext(2, 3, true, ORTHO_EXCLUDE);
+  game_set_constraint(g, 0, 0, 2);
+  game_set_color(g, 0, 1, BLACK);
+  game_set_color(g, 1, 2, WHITE);
+  const char* text = "2 3 1 3\n2e-b-e\n-e-e-w";
+  size_t size = strlen(text);
+  ASSERT(game_save_to_buffer(g, NULL, 0) == size);
+  // Too small: nothing is written.
+  char buffer[64];
+  memset(buffer, '#', sizeof(buffer));
+  ASSERT(game_save_to_buffer(g, buffer, size - 1) == size);
+  ASSERT(buffer[0] == '#');
+  ASSERT(game_save_to_buffer(g, buffer, sizeof(buffer)) == size);
+  ASSERT(memcmp(buffer, text, size) == 0 && buffer[size] == '#');
+
+  // The text of the file.
+  game_save(g, "save_to_buffer.txt");
+  FILE* f = fopen("save_to_buffer.txt", "rb");
+  ASSERT(f);
+  char file[64];
+  size_t file_size = fread(file, 1, sizeof(file), f);
+  fclose(f);
+  remove("save_to_buffer.txt");
+  ASSERT(file_size == size && memcmp(file, text, size) == 0);
+  game_delete(g);
+  return true;
+}
+
+bool test_game_pack_open() {
+  game_pack_writer w = game_pack_create("pack_open.mosp", false);
+  ASSERT(w);
+  ASSERT(game_pack_finish(w));
+  game_pack p = game_pack_open("pack_open.mosp");
+  ASSERT(p && game_pack_count(p) == 0);
+  game_pack_close(p);
+
+  w = game_pack_create("pack_open.mosp", true);
+  ASSERT(w);
+  game g = game_default();
+  for (int i = 0; i < 3; i++) game_pack_add(w, g);
+  game_delete(g);
+  ASSERT(game_pack_finish(w));
+  p = game_pack_open("pack_open.mosp");
+  ASSERT(p && game_pack_count(p) == 3);
+  game_pack_close(p);
+
+  // Invalid packs: wrong magic, unknown version, unknown encoding, count
+  // that does not match the index, and truncated.
+  FILE* f = fopen("pack_open.mosp", "rb");
+  ASSERT(f);
+  unsigned char bytes[4096];
+  size_t size = fread(bytes, 1, sizeof(bytes), f);
+  fclose(f);
+  ASSERT(size > 24 && size < sizeof(bytes));
+  int offsets[] = {0, 4, 5, 8};
+  unsigned char values[] = {'m', 2, 2, 4};
+  for (int t = 0; t < 4; t++) {
+    unsigned char bad[sizeof(bytes)];
+    memcpy(bad, bytes, size);
+    bad[offsets[t]] = values[t];
+    ASSERT(write_bytes("pack_open.mosp", bad, size));
+    ASSERT(game_pack_open("pack_open.mosp") == NULL);
+  }
+  ASSERT(write_bytes("pack_open.mosp", bytes, size - 1));
+  ASSERT(game_pack_open("pack_open.mosp") == NULL);
+  // A header alone, whose count + 1 wraps to the 0 entries of its index.
+  unsigned char header[24] = {'M', 'O', 'S', 'P', 1, 0, 0, 0};
+  memset(header + 8, 0xff, 8);
+  header[16] = 24;
+  ASSERT(write_bytes("pack_open.mosp", header, sizeof(header)));
+  ASSERT(game_pack_open("pack_open.mosp") == NULL);
+  remove("pack_open.mosp");
+  ASSERT(game_pack_open("pack_open.mosp") == NULL);
+  return true;
+}
+
+bool test_game_pack_get() {
+  game games[4] = {game_default(), game_default_solution(),
+                   game_new_empty_ext(3, 5, true, ORTHO),
+                   game_new_empty_ext(1, 1, false, FULL_EXCLUDE)};
+  game_set_constraint(games[2], 1, 4, 3);
+  game_set_color(games[2], 2, 0, BLACK);
+  for (int binary = 0; binary < 2; binary++) {
+    game_pack_writer w = game_pack_create("pack_get.mosp", binary);
+    ASSERT(w);
+    for (int i = 0; i < 4; i++) game_pack_add(w, games[i]);
+    ASSERT(game_pack_finish(w));
+    game_pack p = game_pack_open("pack_get.mosp");
+    ASSERT(p && game_pack_count(p) == 4);
+    // In any order.
+    for (int i = 3; i >= 0; i--) {
+      game g = game_pack_get(p, i);
+      ASSERT(g && game_equal(g, games[i]));
+      ASSERT(game_is_wrapping(g) == game_is_wrapping(games[i]));
+      ASSERT(game_get_neighbourhood(g) == game_get_neighbourhood(games[i]));
+      game_delete(g);
+    }
+    ASSERT(game_pack_get(p, 4) == NULL);
+    game_pack_close(p);
+  }
+  remove("pack_get.mosp");
+  for (int i = 0; i < 4; i++) game_delete(games[i]);
+  return true;
+}
+
+bool test_game_nb_solutions() {
+  game g1 = game_default();
+  ASSERT(g1);
+  game g2 = game_copy(g1);
+  ASSERT(game_nb_solutions(g1) == 1);
+  ASSERT(game_equal(g1, g2));  // the game is unchanged
+
+  // Unconstrained squares can take any color.
+  game g3 = game_new_empty_ext(2, 2, false, FULL);
+  ASSERT(game_nb_solutions(g3) == 16);
+  game_set_constraint(g3, 0, 0, 4);
+  ASSERT(game_nb_solutions(g3) == 1);
+  game_set_constraint(g3, 0, 0, 5);
+  ASSERT(game_nb_solutions(g3) == 0);
+
+  // With wrapping, UP and DOWN of a square in a 1x3 game are the square itself,
+  // so it is counted three times in its ORTHO neighbourhood.
+  game g4 = game_new_empty_ext(1, 3, true, ORTHO);
+  game_set_constraint(g4, 0, 1, 4);
+  ASSERT(game_nb_solutions(g4) == 2);
+
+  // Squares that share no constraint are counted apart: 4 ways for each
+  // corner window and 2 for each of the 8 other squares.
+  game g5 = game_new_empty_ext(4, 4, false, FULL);
+  game_set_constraint(g5, 0, 0, 1);
+  game_set_constraint(g5, 3, 3, 1);
+  ASSERT(game_nb_solutions(g5) == 4 * 4 * 256);
+  ASSERT(game_nb_solutions_upto(g5, 100) == 100);
+  game_set_constraint(g5, 1, 2, 0);
+  ASSERT(game_nb_solutions(g5) == game_nb_solutions_dp(g5));
+  game_set_constraint(g5, 2, 1, 9);
+  ASSERT(game_nb_solutions(g5) == 0);
+
+  // Small components are counted by brute force: C(9,4) ways around (1,1),
+  // times 2 for each of the 3 squares of the last column.
+  game g6 = game_new_empty_ext(3, 4, false, FULL);
+  game_set_constraint(g6, 1, 1, 4);
+  ASSERT(game_nb_solutions(g6) == 126 * 8);
+
+  // Counts that do not fit are reported as UINT_MAX.
+  game g7 = game_new_empty_ext(6, 6, true, ORTHO);
+  ASSERT(game_nb_solutions(g7) == UINT_MAX);
+  // Large enough for the same residual problems to come back many times.
+  for (int k = 0; k < 8; k++) {
+    game g = random_solvable_game(12, 9, k % 2, k / 2);
+    ASSERT(game_nb_solutions(g) == game_nb_solutions_dp(g));
+    game_delete(g);
+  }
+  // The neighbourhood of a lone square without wrapping is empty: a constraint
+  // of 9 is broken before any square is decided.
+  for (int k = 0; k < 2; k++) {
+    game g = game_new_empty_ext(1, 1, false, k ? FULL_EXCLUDE : ORTHO_EXCLUDE);
+    game_set_constraint(g, 0, 0, 9);
+    ASSERT(game_nb_solutions(g) == 0);
+    ASSERT(game_nb_solutions_mt(g, 2) == 0);
+    ASSERT(game_nb_solutions_upto(g, 10) == 0);
+    ASSERT(!game_solve(g));
+    game_delete(g);
+  }
+
+  game_delete(g1);
+  game_delete(g2);
+  game_delete(g3);
+  game_delete(g4);
+  game_delete(g5);
+  game_delete(g6);
+  game_delete(g7);
+  return true;
+}
+
+// Checks each solution given by game_foreach_solution against the constraints
+// of the game in ctx, and counts them.
+typedef struct {
+  game g;
+  uint nb_solutions;
+  uint limit;
+  bool ok;
+} foreach_check;
+
+bool check_solution(const color colors[], void* ctx) {
+  foreach_check* check = ctx;
+  game g = game_copy(check->g);
+  uint nb_cols = game_nb_cols(g);
+  for (uint i = 0; i < game_nb_rows(g); i++)
+    for (uint j = 0; j < nb_cols; j++)
+      game_set_color(g, i, j, colors[i * nb_cols + j]);
+  check->ok = check->ok && game_won(g);
+  game_delete(g);
+  check->nb_solutions++;
+  return check->limit == 0 || check->nb_solutions < check->limit;
+}
+
+bool test_game_foreach_solution() {
+  game g1 = game_default();
+  ASSERT(g1);
+  game g2 = game_copy(g1);
+  foreach_check check = {g1, 0, 0, true};
+  ASSERT(game_foreach_solution(g1, check_solution, &check) == 1);
+  ASSERT(check.ok && check.nb_solutions == 1);
+  ASSERT(game_equal(g1, g2));  // the game is unchanged
+
+  // Every solution is given once, and the enumeration stops when asked to.
+  for (int k = 0; k < 8; k++) {
+    game g = random_solvable_game(4, 5, k % 2, k / 2);
+    game_set_constraint(g, 1, 1, -1);
+    game_set_constraint(g, 2, 3, -1);
+    uint nb_solutions = game_nb_solutions(g);
+    check = (foreach_check){g, 0, 0, true};
+    ASSERT(game_foreach_solution(g, check_solution, &check) == nb_solutions);
+    ASSERT(check.ok && check.nb_solutions == nb_solutions);
+    check = (foreach_check){g, 0, 1, true};
+    ASSERT(game_foreach_solution(g, check_solution, &check) == 1);
+    game_delete(g);
+  }
+
+  game_delete(g1);
+  game_delete(g2);
+  return true;
+}
+
+bool test_game_has_unique_solution() {
+  game g1 = game_default();
+  ASSERT(g1);
+  game g2 = game_copy(g1);
+  ASSERT(game_has_unique_solution(g1));
+  ASSERT(game_equal(g1, g2));  // the game is unchanged
+
+  game g3 = game_new_empty_ext(2, 2, false, FULL);
+  ASSERT(!game_has_unique_solution(g3));  // 16 solutions
+  game_set_constraint(g3, 0, 0, 4);
+  ASSERT(game_has_unique_solution(g3));
+  game_set_constraint(g3, 0, 0, 5);
+  ASSERT(!game_has_unique_solution(g3));  // no solution
+
+  // Same answers as game_nb_solutions.
+  for (int k = 0; k < 16; k++) {
+    game g = random_solvable_game(4, 5, k % 2, k % 4);
+    uint nb_solutions = game_nb_solutions(g);
+    ASSERT(game_has_unique_solution(g) == (nb_solutions == 1));
+    ASSERT(game_nb_solutions_upto(g, 0) == nb_solutions);
+    for (uint limit = 1; limit <= 3; limit++) {
+      uint expected = nb_solutions < limit ? nb_solutions : limit;
+      ASSERT(game_nb_solutions_upto(g, limit) == expected);
+    }
+    game_delete(g);
+  }
+
+  // 2^36 solutions: with no limit, the count saturates like the others.
+  game g4 = game_new_empty_ext(6, 6, false, FULL);
+  ASSERT(game_nb_solutions_upto(g4, 0) == UINT_MAX);
+  ASSERT(game_nb_solutions_upto(g4, 0) == game_nb_solutions(g4));
+  ASSERT(game_nb_solutions_upto(g4, 1000) == 1000);
+  game_delete(g4);
+
+  game_delete(g1);
+  game_delete(g2);
+  game_delete(g3);
+  return true;
+}
+
+bool test_game_nb_solutions_mt() {
+  game g1 = game_default();
+  ASSERT(g1);
+  game g2 = game_copy(g1);
+  ASSERT(game_nb_solutions_mt(g1, 4) == 1);
+  ASSERT(game_equal(g1, g2));  // the game is unchanged
+
+  // Same counts as game_nb_solutions, whatever the number of threads, on
+  // games with many solutions so that the threads have subtrees to steal.
+  for (int k = 0; k < 8; k++) {
+    game g = random_solvable_game(5, 6, k % 2, k / 2);
+    for (uint i = 0; i < 5; i++)
+      for (uint j = 0; j < 6; j += 3) game_set_constraint(g, i, j, -1);
+    uint nb_solutions = game_nb_solutions(g);
+    for (unsigned nthreads = 0; nthreads <= 5; nthreads++)
+      ASSERT(game_nb_solutions_mt(g, nthreads) == nb_solutions);
+    game_delete(g);
+  }
+
+  // A game without solution.
+  game g3 = game_new_empty_ext(3, 3, false, FULL);
+  game_set_constraint(g3, 0, 0, 9);
+  ASSERT(game_nb_solutions_mt(g3, 3) == 0);
+
+  // Counts that do not fit are reported as UINT_MAX, as by game_nb_solutions.
+  game g4 = game_new_empty_ext(6, 6, true, ORTHO);
+  ASSERT(game_nb_solutions_mt(g4, 3) == UINT_MAX);
+
+  game_delete(g1);
+  game_delete(g2);
+  game_delete(g3);
+  game_delete(g4);
+  return true;
+}
+
+bool test_game_nb_solutions_dp() {
+  game g1 = game_default();
+  ASSERT(g1);
+  game g2 = game_copy(g1);
+  ASSERT(game_nb_solutions_dp(g1) == 1);
+  ASSERT(game_equal(g1, g2));  // the game is unchanged
+
+  // Same counts as game_nb_solutions, for every neighbourhood, with and
+  // without wrapping, including grids narrow enough for a square to be its
+  // own neighbour.
+  for (uint nb_rows = 1; nb_rows <= 5; nb_rows++)
+    for (uint nb_cols = 1; nb_cols <= 5; nb_cols++)
+      for (int k = 0; k < 8; k++) {
+        game g = random_solvable_game(nb_rows, nb_cols, k % 2, k / 2);
+        uint nb_solutions = game_nb_solutions_dp(g);
+        ASSERT(nb_solutions >= 1);
+        ASSERT(nb_solutions == game_nb_solutions(g));
+        game_delete(g);
+      }
+
+  // Counts that do not fit are reported as UINT_MAX.
+  game g3 = game_new_empty_ext(7, 5, false, FULL);
+  ASSERT(game_nb_solutions_dp(g3) == UINT_MAX);
+
+  game_delete(g1);
+  game_delete(g2);
+  game_delete(g3);
+  return true;
+}
+
 void usage(int argc, char* argv[]) {
   fprintf(stderr, "Usage: %s <testname> [<...>]\n", argv[0]);
   exit(EXIT_FAILURE);
@@ -374,6 +1147,42 @@ int main(int argc, char* argv[]) {
     ok = test_game_play_move();
   } else if (strcmp("game_get_neighbourhood", argv[1]) == 0) {
     ok = test_game_get_neighbourhood();
+  } else if (strcmp("game_get_status_map", argv[1]) == 0) {
+    ok = test_game_get_status_map();
+  } else if (strcmp("game_solve", argv[1]) == 0) {
+    ok = test_game_solve();
+  } else if (strcmp("game_solve_opts", argv[1]) == 0) {
+    ok = test_game_solve_opts();
+  } else if (strcmp("game_solve_ext", argv[1]) == 0) {
+    ok = test_game_solve_ext();
+  } else if (strcmp("game_solve_sat", argv[1]) == 0) {
+    ok = test_game_solve_sat();
+  } else if (strcmp("game_save_cnf", argv[1]) == 0) {
+    ok = test_game_save_cnf();
+  } else if (strcmp("game_save_binary", argv[1]) == 0) {
+    ok = test_game_save_binary();
+  } else if (strcmp("game_load", argv[1]) == 0) {
+    ok = test_game_load();
+  } else if (strcmp("game_load_from_buffer", argv[1]) == 0) {
+    ok = test_game_load_from_buffer();
+  } else if (strcmp("game_save_to_buffer", argv[1]) == 0) {
+    ok = test_game_save_to_buffer();
+  } else if (strcmp("game_pack_open", argv[1]) == 0) {
+    ok = test_game_pack_open();
+  } else if (strcmp("game_pack_get", argv[1]) == 0) {
+    ok = test_game_pack_get();
+  } else if (strcmp("game_load_binary", argv[1]) == 0) {
+    ok = test_game_load_binary();
+  } else if (strcmp("game_nb_solutions", argv[1]) == 0) {
+    ok = test_game_nb_solutions();
+  } else if (strcmp("game_foreach_solution", argv[1]) == 0) {
+    ok = test_game_foreach_solution();
+  } else if (strcmp("game_has_unique_solution", argv[1]) == 0) {
+    ok = test_game_has_unique_solution();
+  } else if (strcmp("game_nb_solutions_mt", argv[1]) == 0) {
+    ok = test_game_nb_solutions_mt();
+  } else if (strcmp("game_nb_solutions_dp", argv[1]) == 0) {
+    ok = test_game_nb_solutions_dp();
   } else {
     fprintf(stderr, "Error: test \"%s\" not found!\n", argv[1]);
     exit(EXIT_FAILURE);
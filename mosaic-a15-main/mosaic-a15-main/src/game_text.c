@@ -14,6 +14,7 @@ int main(int argc, char* argv[]) {
     g = game_default();
   } else {
     g = game_load(argv[1]);
+    if (g == NULL) return EXIT_FAILURE;
   }
   bool quit = false;
 
@@ -21,10 +22,17 @@ int main(int argc, char* argv[]) {
     game_print(g);
     printf("? [h for help]\n");
 
+    status* map = malloc(g->height * g->width * sizeof(status));
+    if (map == NULL) {
+      fprintf(stderr, "Memory allocation failed");
+      exit(EXIT_FAILURE);
+    }
+    game_get_status_map(g, map);
     for (int i = 0; i < g->height; i++)
       for (int j = 0; j < g->width; j++)
-        if (game_get_status(g, i, j) == ERROR)
+        if (map[i * g->width + j] == ERROR)
           printf("Square (%d %d) : Error\n", i, j);
+    free(map);
 
     char c;
     int r = scanf(" %c", &c);
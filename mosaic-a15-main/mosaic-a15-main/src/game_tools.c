@@ -1,259 +1,1937 @@
 #ifndef _GAME_TOOLS_H
 #define _GAME_TOOLS_H
+// clock_gettime
+#define _POSIX_C_SOURCE 200809L
 #include "game_tools.h"
 
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "game_aux.h"
+#include "game_bitboard.h"
+#include "game_file.h"
+#include "game_kernels.h"
+#include "game_sat.h"
 #include "game_struct.h"
+#include "game_sums.h"
 #endif
 
-game game_load(char* filename) {
-  int rows = 0;
-  int columns = 0;
-  int wrapping = 0;
-  int neighbourhood = 0;
-  FILE* fp = fopen(filename, "r");
-  if (!(fscanf(fp, "%d %d %d %d", &rows, &columns, &wrapping, &neighbourhood) ==
-        4))
-    exit(EXIT_FAILURE);
-  int constraints[rows * columns];
-  color colors[rows * columns];
-  char next_color;
-  char next_constraint;
-  fgetc(fp);
-  for (int i = 0; i < rows; i++) {
-    for (int j = 0; j < columns; j++) {
-      if (!(fscanf(fp, "%c %c", &next_constraint, &next_color) == 2))
-        exit(EXIT_FAILURE);
-      switch (next_color) {
-        case 'e':
-          colors[i * columns + j] = EMPTY;
-          break;
-        case 'b':
-          colors[i * columns + j] = BLACK;
-          break;
-        case 'w':
-          colors[i * columns + j] = WHITE;
-          break;
-      }
-      switch (next_constraint) {
-        case '-':
-          constraints[i * columns + j] = -1;
-          break;
-
-        default:
-          constraints[i * columns + j] = atoi(&next_constraint);
-          break;
-      }
+/* Reading position in a text game file, kept for the error messages. */
+typedef struct {
+  const char* filename;
+  const char* p;
+  const char* end;
+  const char* line_start;
+  uint line;
+} text_scanner;
+
+/* Reports what is wrong at the position of s, in its file if it has one. */
+static void text_error(const text_scanner* s, const char* message) {
+  if (s->filename != NULL) fprintf(stderr, "%s:", s->filename);
+  fprintf(stderr, "%u:%zu: %s\n", s->line, (size_t)(s->p - s->line_start) + 1,
+          message);
+}
+
+/* Reads an unsigned number, after spaces. */
+static bool text_number(text_scanner* s, uint* n) {
+  while (s->p < s->end && (*s->p == ' ' || *s->p == '\t')) s->p++;
+  if (s->p == s->end || *s->p < '0' || *s->p > '9') {
+    text_error(s, "expected a number");
+    return false;
+  }
+  uint64_t value = 0;
+  while (s->p < s->end && *s->p >= '0' && *s->p <= '9') {
+    value = 10 * value + (*s->p++ - '0');
+    if (value > UINT_MAX) {
+      text_error(s, "number too large");
+      return false;
     }
-    fgetc(fp);
   }
-  game g =
-      game_new_ext(rows, columns, constraints, colors, wrapping, neighbourhood);
-  fclose(fp);
+  *n = value;
+  return true;
+}
+
+/* Reads the end of a line, '\n' or "\r\n", or the end of the file when
+last is set. */
+static bool text_end_of_line(text_scanner* s, bool last) {
+  while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\r'))
+    s->p++;
+  if (s->p < s->end && *s->p == '\n') {
+    s->p++;
+    s->line++;
+    s->line_start = s->p;
+    return true;
+  }
+  if (s->p == s->end && last) return true;
+  text_error(s, s->p == s->end ? "unexpected end of file"
+                               : "expected the end of the line");
+  return false;
+}
+
+/* Codes of the characters of a square, or 0 when invalid: bit 7 is set for
+the valid characters, under the constraint plus one (bits 2 to 5) or the color
+(bits 0 and 1) as game_s::cells holds them. */
+static const uint8_t text_constraints[256] = {
+    ['-'] = 0x80,          ['0'] = 0x80 | 1 << 2, ['1'] = 0x80 | 2 << 2,
+    ['2'] = 0x80 | 3 << 2, ['3'] = 0x80 | 4 << 2, ['4'] = 0x80 | 5 << 2,
+    ['5'] = 0x80 | 6 << 2, ['6'] = 0x80 | 7 << 2, ['7'] = 0x80 | 8 << 2,
+    ['8'] = 0x80 | 9 << 2, ['9'] = 0x80 | 10 << 2};
+static const uint8_t text_colors[256] = {
+    ['e'] = 0x80 | EMPTY, ['w'] = 0x80 | WHITE, ['b'] = 0x80 | BLACK};
+
+/* Finds and reports the first invalid square of a row that text_row could
+not read. */
+static void text_row_error(text_scanner* s, uint nb_cols) {
+  for (uint j = 0; j < 2 * nb_cols; j++, s->p++) {
+    if (s->p == s->end) {
+      text_error(s, "unexpected end of file");
+      return;
+    }
+    const uint8_t* codes = j % 2 == 0 ? text_constraints : text_colors;
+    if (codes[(unsigned char)*s->p] == 0) {
+      text_error(s, j % 2 == 0 ? "expected a constraint, '-' or a digit"
+                               : "expected a color, 'e', 'w' or 'b'");
+      return;
+    }
+  }
+}
+
+/* Reads a row of nb_cols squares into cells. The squares are decoded with no
+branch, and checked once for the whole row. */
+static bool text_row(text_scanner* s, uint nb_cols, uint8_t* cells) {
+  if (s->end - s->p >= 2 * (ptrdiff_t)nb_cols) {
+    const unsigned char* p = (const unsigned char*)s->p;
+    uint8_t valid = 0x80;
+    for (uint j = 0; j < nb_cols; j++) {
+      uint8_t constraint = text_constraints[p[2 * j]];
+      uint8_t color = text_colors[p[2 * j + 1]];
+      valid &= constraint & color;
+      cells[j] = (constraint | color) & 0x7f;
+    }
+    if (valid) {
+      s->p += 2 * (size_t)nb_cols;
+      return true;
+    }
+  }
+  text_row_error(s, nb_cols);
+  return false;
+}
+
+/* Parses the size bytes of data, read from filename or NULL. */
+static game text_parse(const char* filename, const char* data, size_t size) {
+  text_scanner s = {filename, data, data + size, data, 1};
+  uint nb_rows, nb_cols, wrapping, neighbourhood;
+  if (!text_number(&s, &nb_rows) || !text_number(&s, &nb_cols) ||
+      !text_number(&s, &wrapping) || !text_number(&s, &neighbourhood))
+    return NULL;
+  if (nb_rows == 0 || nb_cols == 0 || wrapping > 1 ||
+      neighbourhood > ORTHO_EXCLUDE) {
+    text_error(&s, "invalid size, wrapping or neighbourhood");
+    return NULL;
+  }
+  // Two characters per square: a truncated file is found before the game
+  // is allocated, whatever the size it claims.
+  if ((size_t)nb_rows * nb_cols > size / 2) {
+    text_error(&s, "file too short for its number of squares");
+    return NULL;
+  }
+  if (!text_end_of_line(&s, false)) return NULL;
+  game g = game_new_empty_ext(nb_rows, nb_cols, wrapping, neighbourhood);
+  for (uint i = 0; i < nb_rows; i++) {
+    if (!text_row(&s, nb_cols, g->cells + (size_t)i * nb_cols) ||
+        !text_end_of_line(&s, i == nb_rows - 1)) {
+      game_delete(g);
+      return NULL;
+    }
+  }
+  while (s.p < s.end && (*s.p == ' ' || *s.p == '\t' || *s.p == '\r' ||
+                         *s.p == '\n')) {
+    if (*s.p++ == '\n') {
+      s.line++;
+      s.line_start = s.p;
+    }
+  }
+  if (s.p != s.end) {
+    text_error(&s, "unexpected characters after the last row");
+    game_delete(g);
+    return NULL;
+  }
+  game_sync(g);
   return g;
 }
 
+game game_load_from_buffer(const char* buffer, size_t size) {
+  return text_parse(NULL, buffer, size);
+}
+
+game game_load(char* filename) {
+  mapped_file f;
+  if (!file_map(filename, &f, true)) return NULL;
+  game g = text_parse(filename, f.data, f.size);
+  file_unmap(&f);
+  return g;
+}
+
+size_t game_save_to_buffer(cgame g, char* buffer, size_t size) {
+  char header[64];
+  int header_size = snprintf(header, sizeof(header), "%u %u %d %d", g->height,
+                             g->width, g->wrapping, g->neighbourhood);
+  // Each row is a newline and 2 characters per square.
+  size_t text_size =
+      header_size + (size_t)g->height * (1 + 2 * (size_t)g->width);
+  if (buffer == NULL || size < text_size) return text_size;
+  memcpy(buffer, header, header_size);
+  char* p = buffer + header_size;
+  const char colors[3] = {'e', 'w', 'b'};
+  for (uint i = 0; i < g->height; i++) {
+    *p++ = '\n';
+    for (uint j = 0; j < g->width; j++) {
+      size_t k = (size_t)g->width * i + j;
+      int n = cell_constraint(g, k);
+      *p++ = n == UNCONSTRAINED ? '-' : '0' + n;
+      *p++ = colors[cell_color(g, k)];
+    }
+  }
+  return text_size;
+}
+
 void game_save(cgame g, char* filename) {
+  size_t size = game_save_to_buffer(g, NULL, 0);
+  char* buffer = malloc(size);
+  if (buffer == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  game_save_to_buffer(g, buffer, size);
   FILE* f = fopen(filename, "wb");
-  int main_parameters[4] = {game_nb_rows(g), game_nb_cols(g),
-                            game_is_wrapping(g), game_get_neighbourhood(g)};
-  fprintf(f, "%d", main_parameters[0]);
-  for (int i = 1; i < 4; i++) {
-    fprintf(f, " %d", main_parameters[i]);
-  }
-
-  char col[3] = {'e', 'w', 'b'};
-  for (int i = 0; i < game_nb_rows(g); i++) {
-    fprintf(f, "\n");
-    for (int j = 0; j < game_nb_cols(g); j++) {
-      int cons = game_get_constraint(g, i, j);
-      int col_index = game_get_color(g, i, j);
-      if (cons != -1) {
-        fprintf(f, "%c%c", (cons + '0'), col[col_index]);
-      } else {
-        fprintf(f, "-%c", col[col_index]);
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  fwrite(buffer, 1, size, f);
+  fclose(f);
+  free(buffer);
+}
+
+void fillsquares(game g, int i, int j, color c, int index_squares[],
+                 int* solved_squares) {
+  uint squares_buffer[9];
+  int array_length;
+  const uint* squares = game_neighbours(g, i * g->width + j, &array_length,
+                                        squares_buffer);
+  for (int k = 0; k < array_length; k++) {
+    if (cell_color(g, squares[k]) == EMPTY) {
+      bb_set_square(g, squares[k], c);
+      index_squares[*solved_squares] = squares[k];
+      *solved_squares += 1;
+    }
+  }
+}
+
+/* Applies the two saturation rules to the constraint of square (i,j): a
+constraint that already has all its black squares gets the rest of its
+neighbourhood in white, and a constraint that needs all its empty squares gets
+them in black. Every square colored here is appended to index_squares. Returns
+false if the square is in ERROR, i.e. the current colors cannot lead to a
+solution. */
+bool saturate_square(game g, int i, int j, int index_squares[],
+                     int* solved_squares) {
+  constraint constraint = cell_constraint(g, i * g->width + j);
+  if (constraint == UNCONSTRAINED) return true;
+  int nb_squares, nb_black, nb_decided;
+  bb_window(g, i, j, &nb_squares, &nb_black, &nb_decided);
+  int nb_empty = nb_squares - nb_decided;
+  int missing = constraint - nb_black;  // black squares still needed
+  if (missing < 0 || nb_empty < missing) return false;  // ERROR
+  if (nb_empty == 0) return true;                        // SATISFIED
+  if (missing == 0)
+    fillsquares(g, i, j, WHITE, index_squares, solved_squares);
+  else if (nb_empty == missing)
+    fillsquares(g, i, j, BLACK, index_squares, solved_squares);
+  return true;
+}
+
+/* Propagates the squares colored in index_squares from position head: only
+the constraints whose neighbourhood contains one of these squares can change,
+and the squares they color are appended to index_squares and propagated in
+turn. Returns false as soon as a square is in ERROR, and then sets *failed to
+that square when failed is not NULL. */
+bool propagate_squares(game g, int index_squares[], int* solved_squares,
+                       int head, int* failed) {
+  const uint* masks = bb_masks[g->neighbourhood];
+  int rows[3], cols[3];
+  while (head < *solved_squares) {
+    int i = index_squares[head] / g->width;
+    int j = index_squares[head] % g->width;
+    head++;
+    // The neighbourhoods are symmetric: the constraints that see (i,j) are the
+    // ones of the neighbourhood of (i,j).
+    bb_window_lines(g, i, j, rows, cols);
+    for (int r = 0; r < 3; r++) {
+      if (rows[r] < 0) continue;
+      for (int c = 0; c < 3; c++) {
+        if (((masks[r] >> c) & 1) && cols[c] >= 0 &&
+            !saturate_square(g, rows[r], cols[c], index_squares,
+                             solved_squares)) {
+          if (failed != NULL) *failed = rows[r] * g->width + cols[c];
+          return false;
+        }
       }
     }
   }
-  fclose(f);
+  return true;
 }
 
-int pow2(int n) {
-  // Math.h libraries seems to not be usable for moodle, so this will have to do
-  int result = 1;
-  for (int i = 0; i < n; i++) {
-    result = result * 2;
+/* Fills squares with the EMPTY squares of the neighbourhood of square q and
+missing with the number of black squares it still needs. Returns the number of
+EMPTY squares, or -1 when the neighbourhood holds a square more than once,
+which only happens in wrapping grids narrower than 3 squares. */
+int window_empty(cgame g, int q, int squares[9], int* missing) {
+  if (g->wrapping && (g->height < 3 || g->width < 3)) return -1;
+  uint window_buffer[9];
+  int n;
+  const uint* window = game_neighbours(g, q, &n, window_buffer);
+  int nb_empty = 0, nb_black = 0;
+  for (int l = 0; l < n; l++) {
+    if (cell_color(g, window[l]) == EMPTY)
+      squares[nb_empty++] = window[l];
+    else if (cell_color(g, window[l]) == BLACK)
+      nb_black++;
   }
-  return result;
+  *missing = cell_constraint(g, q) - nb_black;
+  return nb_empty;
 }
-void fillsquares(game g, int i, int j, color c, int index_squares[],
-                 int* solved_squares) {
-  unsigned int i2;
-  unsigned int j2;
-  int width = g->width;
-  int array_length = 0;
-  direction directions[9];
-
-  if (g->neighbourhood == FULL) {
-    directions[0] = UP_LEFT;
-    directions[1] = UP;
-    directions[2] = UP_RIGHT;
-    directions[3] = LEFT;
-    directions[4] = HERE;
-    directions[5] = RIGHT;
-    directions[6] = DOWN_LEFT;
-    directions[7] = DOWN;
-    directions[8] = DOWN_RIGHT;
-    array_length = 9;
-  }
-  if (g->neighbourhood == ORTHO) {
-    directions[0] = UP;
-    directions[1] = LEFT;
-    directions[2] = HERE;
-    directions[3] = RIGHT;
-    directions[4] = DOWN;
-    array_length = 5;
-  }
-
-  if (g->neighbourhood == FULL_EXCLUDE) {
-    directions[0] = UP_LEFT;
-    directions[1] = UP;
-    directions[2] = UP_RIGHT;
-    directions[3] = LEFT;
-    directions[4] = RIGHT;
-    directions[5] = DOWN_LEFT;
-    directions[6] = DOWN;
-    directions[7] = DOWN_RIGHT;
-    array_length = 8;
-  }
-
-  if (g->neighbourhood == ORTHO_EXCLUDE) {
-    directions[0] = UP;
-    directions[1] = LEFT;
-    directions[2] = RIGHT;
-    directions[3] = DOWN;
-    array_length = 4;
+
+/* Colors the n squares of squares in c, and appends them to index_squares. */
+void fill_list(game g, const int squares[], int n, color c,
+               int index_squares[], int* solved_squares) {
+  for (int l = 0; l < n; l++) {
+    bb_set_square(g, squares[l], c);
+    index_squares[*solved_squares] = squares[l];
+    *solved_squares += 1;
   }
+}
 
-  for (int k = 0; k < array_length; k++) {
-    if (game_get_next_square(g, i, j, directions[k], &i2, &j2) &&
-        game_get_color(g, i2, j2) == EMPTY) {
-      game_set_color(g, i2, j2, c);
-      index_squares[*solved_squares] = i2 * width + j2;
-      *solved_squares += 1;
+/* Applies the pair rules to the constraints of squares q and p, whose
+neighbourhoods A and B overlap. The black squares still needed by A and B
+bound the number of black squares in the overlap, and so in A \ B and B \ A:
+each of these three parts is colored when its bounds leave it no choice. When
+A is a subset of B, the difference between the two constraints thus colors
+B \ A. Returns false if the bounds are contradictory. */
+bool pair_squares(game g, int q, int p, int index_squares[],
+                  int* solved_squares) {
+  int a[9], b[9], missing_a, missing_b;
+  int nb_a = window_empty(g, q, a, &missing_a);
+  if (nb_a <= 0) return true;
+  int nb_b = window_empty(g, p, b, &missing_b);
+  if (nb_b <= 0) return true;
+  int only_a[9], only_b[9], common[9];
+  int nb_only_a = 0, nb_only_b = 0, nb_common = 0;
+  for (int l = 0; l < nb_a; l++) {
+    bool shared = false;
+    for (int m = 0; m < nb_b; m++) shared = shared || a[l] == b[m];
+    if (shared)
+      common[nb_common++] = a[l];
+    else
+      only_a[nb_only_a++] = a[l];
+  }
+  if (nb_common == 0) return true;
+  for (int m = 0; m < nb_b; m++) {
+    bool shared = false;
+    for (int l = 0; l < nb_common; l++) shared = shared || b[m] == common[l];
+    if (!shared) only_b[nb_only_b++] = b[m];
+  }
+
+  // Bounds of the number of black squares in the overlap.
+  int low = 0;
+  if (missing_a - nb_only_a > low) low = missing_a - nb_only_a;
+  if (missing_b - nb_only_b > low) low = missing_b - nb_only_b;
+  int high = nb_common;
+  if (missing_a < high) high = missing_a;
+  if (missing_b < high) high = missing_b;
+  if (low > high) return false;
+
+  if (missing_a - high == nb_only_a)
+    fill_list(g, only_a, nb_only_a, BLACK, index_squares, solved_squares);
+  else if (missing_a - low == 0)
+    fill_list(g, only_a, nb_only_a, WHITE, index_squares, solved_squares);
+  if (missing_b - high == nb_only_b)
+    fill_list(g, only_b, nb_only_b, BLACK, index_squares, solved_squares);
+  else if (missing_b - low == 0)
+    fill_list(g, only_b, nb_only_b, WHITE, index_squares, solved_squares);
+  if (low == nb_common)
+    fill_list(g, common, nb_common, BLACK, index_squares, solved_squares);
+  else if (high == 0)
+    fill_list(g, common, nb_common, WHITE, index_squares, solved_squares);
+  return true;
+}
+
+/* Applies the pair rules to the constraint of square q and the constraints
+within two rows and two columns of it, whose neighbourhoods can overlap with
+its own, and propagates the squares they color. Returns false as soon as a
+square is in ERROR. */
+bool pair_constraint(game g, int q, int index_squares[], int* solved_squares) {
+  int width = g->width;
+  int height = g->height;
+  int nb_squares, nb_black, nb_decided;
+  bb_window(g, q / width, q % width, &nb_squares, &nb_black, &nb_decided);
+  if (nb_decided == nb_squares) return true;
+  for (int di = -2; di <= 2; di++) {
+    int i = q / width + di;
+    if (g->wrapping) i = (i + 2 * height) % height;
+    if (i < 0 || i >= height) continue;
+    for (int dj = -2; dj <= 2; dj++) {
+      int j = q % width + dj;
+      if (g->wrapping) j = (j + 2 * width) % width;
+      if (j < 0 || j >= width) continue;
+      int p = i * width + j;
+      if (p == q || cell_constraint(g, p) == UNCONSTRAINED) continue;
+      int head = *solved_squares;
+      if (!pair_squares(g, q, p, index_squares, solved_squares) ||
+          !propagate_squares(g, index_squares, solved_squares, head, NULL))
+        return false;
     }
   }
+  return true;
 }
 
-int presolve_game(game g, int index_squares[]) {
+/* Queue of the constraints to examine, each at most once at a time. */
+typedef struct {
+  int* items;  // circular, from first
+  bool* queued;
+  int first;
+  int size;
+  int capacity;  // number of squares of the grid
+} worklist;
+
+void worklist_init(worklist* w, int capacity) {
+  w->items = malloc(capacity * sizeof(int));
+  w->queued = calloc(capacity, sizeof(bool));
+  if (w->items == NULL || w->queued == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  w->first = 0;
+  w->size = 0;
+  w->capacity = capacity;
+}
+
+void worklist_free(worklist* w) {
+  free(w->items);
+  free(w->queued);
+}
+
+void worklist_push(worklist* w, int q) {
+  if (w->queued[q]) return;
+  w->queued[q] = true;
+  w->items[(w->first + w->size) % w->capacity] = q;
+  w->size++;
+}
+
+/* Returns the oldest constraint of the queue, or -1 if it is empty. */
+int worklist_pop(worklist* w) {
+  if (w->size == 0) return -1;
+  int q = w->items[w->first];
+  w->first = (w->first + 1) % w->capacity;
+  w->size--;
+  w->queued[q] = false;
+  return q;
+}
+
+/* Saturates every constraint once and propagates the squares colored, which
+brings the single rules to their fixpoint. The pair rules are then applied
+from a worklist of constraints: every constraint at first, then only the
+constraints that see a square colored since they were examined. The work is
+thus proportional to the number of squares colored rather than to the size of
+the grid times the number of passes. Returns false as soon as a square is in
+ERROR. */
+bool presolve_game(game g, int index_squares[], int* solved_squares) {
   int width = g->width;
   int height = g->height;
-  int solved_squares = 0;
-  int test_flag = -1;
-  while (solved_squares != test_flag) {
-    test_flag = solved_squares;
-    for (int i = 0; i < height; i++) {
-      for (int j = 0; j < width; j++) {
-        constraint constraint = game_get_constraint(g, i, j);
-        if (constraint != UNCONSTRAINED &&
-            game_get_status(g, i, j) == UNSATISFIED) {
-          if (constraint - game_nb_neighbors(g, i, j, BLACK) == 0)
-            fillsquares(g, i, j, WHITE, index_squares, &solved_squares);
-          else if (game_nb_neighbors(g, i, j, EMPTY) ==
-                   constraint - game_nb_neighbors(g, i, j, BLACK))
-            fillsquares(g, i, j, BLACK, index_squares, &solved_squares);
-        }
+  int head = *solved_squares;
+  // The counts of a whole row tell which constraints a rule applies to.
+  window_sums sums;
+  window_sums_init(&sums, g);
+  uint8_t* black = malloc(2 * width);
+  if (black == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  uint8_t* empty = black + width;
+  bool consistent = true;
+  for (int i = 0; i < height && consistent; i++) {
+    window_sums_row(&sums, i, black, empty);
+    for (int j = 0; j < width && consistent; j++) {
+      constraint n = cell_constraint(g, i * width + j);
+      if (n == UNCONSTRAINED) continue;
+      int missing = n - black[j];
+      // A window with no EMPTY square is never examined again: its ERROR is
+      // found here or not at all.
+      if (missing < 0 || empty[j] < missing) {
+        consistent = false;
+        break;
+      }
+      if (empty[j] == 0 ||
+          (missing > 0 && missing < empty[j]))
+        continue;
+      int mark = *solved_squares;
+      consistent = saturate_square(g, i, j, index_squares, solved_squares);
+      if (*solved_squares != mark) window_sums_reset(&sums);
+    }
+  }
+  free(black);
+  window_sums_free(&sums);
+  if (!consistent ||
+      !propagate_squares(g, index_squares, solved_squares, head, NULL))
+    return false;
+
+  worklist w;
+  worklist_init(&w, height * width);
+  for (int q = 0; q < height * width; q++) {
+    if (cell_constraint(g, q) != UNCONSTRAINED) worklist_push(&w, q);
+  }
+  int q;
+  while (consistent && (q = worklist_pop(&w)) >= 0) {
+    int mark = *solved_squares;
+    consistent = pair_constraint(g, q, index_squares, solved_squares);
+    // The neighbourhoods are symmetric: the constraints that see a square are
+    // the ones of its neighbourhood.
+    for (int t = mark; consistent && t < *solved_squares; t++) {
+      int k = index_squares[t];
+      uint window_buffer[9];
+      int n;
+      const uint* window = game_neighbours(g, k, &n, window_buffer);
+      for (int l = 0; l < n; l++) {
+        if (cell_constraint(g, window[l]) != UNCONSTRAINED)
+          worklist_push(&w, window[l]);
       }
     }
   }
-  return solved_squares;
+  worklist_free(&w);
+  return consistent;
 }
-void fill_game(game g, short int word[], uint squares[], uint len) {
-  for (int k = 0; k < len; k++) {
-    int i = squares[k] / (g->width);
-    int j = squares[k] % (g->width);
-    game_set_color(g, i, j, word[k]);
+
+/* A branching point of the search: the square that was decided and its index
+among the squares searched, the color it was given, the length of the trail
+before the decision, and whether the other color is left to try. */
+typedef struct {
+  int square;
+  int index;
+  color c;
+  int mark;
+  bool last;
+} decision;
+
+/* State of a depth-first search over the EMPTY squares of g, in the order
+chosen by its branching heuristic, trying WHITE before BLACK and propagating
+the saturation rules after every decision. Squares colored since the root are
+kept in a trail so that backtracking only undoes what the branch has
+changed. */
+typedef struct search_s {
+  game g;
+  int* index_squares;  // the trail
+  int solved_squares;
+  int base;        // length of the trail after presolve_game
+  bool presolved;  // presolve_game found no contradiction
+  decision* stack;
+  int depth;
+  bool consistent;
+  bool on_solution;  // search_next stopped on a solution
+  // The squares to decide, in row-major order, or NULL for all of them.
+  const int* squares;
+  int nb_squares;
+  branching branching;
+  uint* weights;  // of the constraints, for BRANCH_WDEG
+  // Budgets of the search, or NULL for none.
+  const solve_opts* opts;
+  double start;  // time of search_init, in seconds
+  unsigned long nb_nodes;
+  bool stopped;  // search_next ran out of budget
+} search;
+
+/* Colors back to EMPTY every square of the trail recorded after mark. */
+void undo_squares(game g, int index_squares[], int* solved_squares, int mark) {
+  while (*solved_squares > mark) {
+    *solved_squares -= 1;
+    int k = index_squares[*solved_squares];
+    bb_set_square(g, k, EMPTY);
   }
 }
 
-void genWord(int num, int len, short int* word) {
-  for (int i = len - 1; i >= 0; i--) {
-    word[i] = (num % 2) + 1;
-    num = num >> 1;
+bool decide_square(game g, int k, color c, int index_squares[],
+                   int* solved_squares, int* failed) {
+  bb_set_square(g, k, c);
+  index_squares[*solved_squares] = k;
+  *solved_squares += 1;
+  return propagate_squares(g, index_squares, solved_squares,
+                           *solved_squares - 1, failed);
+}
+
+/* Wall-clock time in seconds, from an arbitrary origin. */
+double solve_clock(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* Starts a search over g, which must only have EMPTY squares. */
+void search_init(search* s, game g) {
+  int size = g->height * g->width;
+  s->g = g;
+  s->index_squares = malloc(size * sizeof(int));
+  s->stack = malloc(size * sizeof(decision));
+  s->weights = malloc(size * sizeof(uint));
+  if (s->index_squares == NULL || s->stack == NULL || s->weights == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
   }
+  s->solved_squares = 0;
+  s->consistent = presolve_game(g, s->index_squares, &s->solved_squares);
+  s->base = s->solved_squares;
+  s->presolved = s->consistent;
+  s->depth = 0;
+  s->on_solution = false;
+  s->squares = NULL;
+  s->nb_squares = size;
+  s->branching = BRANCH_ROW_MAJOR;
+  for (int q = 0; q < size; q++) s->weights[q] = 1;
+  s->opts = NULL;
+  s->start = solve_clock();
+  s->nb_nodes = 0;
+  s->stopped = false;
 }
 
-bool game_solve(game g) {
-  game_restart(g);
-  uint len_words = g->height * g->width;
-  int index_squares[len_words];
-  int squares_solved = presolve_game(g, index_squares);
-  if (game_won(g)) {
-    return true;
+void search_free(search* s) {
+  free(s->index_squares);
+  free(s->stack);
+  free(s->weights);
+}
+
+/* Pushes a decision on the square of index k among the squares searched, and
+propagates it. */
+void search_decide(search* s, int k, color c, bool last) {
+  int square = s->squares != NULL ? s->squares[k] : k;
+  s->stack[s->depth] = (decision){square, k, c, s->solved_squares, last};
+  s->depth++;
+  s->nb_nodes++;
+  int failed = -1;
+  s->consistent = decide_square(s->g, square, c, s->index_squares,
+                                &s->solved_squares, &failed);
+  // dom/wdeg learns which constraints fail.
+  if (!s->consistent && failed >= 0) s->weights[failed]++;
+}
+
+/* Restricts the search to the nb_squares squares of squares, given in
+row-major order, from the current state: the squares already colored stay so,
+and the search ends when the given squares are all colored. The current state
+must be consistent. */
+void search_focus(search* s, const int squares[], int nb_squares) {
+  s->consistent = true;
+  s->depth = 0;
+  s->on_solution = false;
+  s->squares = squares;
+  s->nb_squares = nb_squares;
+}
+
+/* Score of the EMPTY square k for the branching heuristic of s, the lowest
+being decided first. BRANCH_MOST_CONSTRAINED takes the smallest slack of the
+constraints that see k: how many squares of the window can still take the
+less needed color. BRANCH_WDEG takes the sum of the weights of the constraints
+that see k and another EMPTY square, each weight counting the failures of its
+constraint. */
+int branch_score(const search* s, int k) {
+  cgame g = s->g;
+  uint window_buffer[9];
+  int n;
+  const uint* window = game_neighbours(g, k, &n, window_buffer);
+  int score = s->branching == BRANCH_WDEG ? 0 : INT_MAX;
+  for (int l = 0; l < n; l++) {
+    int q = window[l];
+    if (cell_constraint(g, q) == UNCONSTRAINED) continue;
+    int nb_squares, nb_black, nb_decided;
+    bb_window(g, q / g->width, q % g->width, &nb_squares, &nb_black,
+              &nb_decided);
+    int nb_empty = nb_squares - nb_decided;
+    int missing = cell_constraint(g, q) - nb_black;
+    if (s->branching == BRANCH_WDEG) {
+      if (nb_empty >= 2) score -= s->weights[q];
+    } else {
+      int slack = missing < nb_empty - missing ? missing : nb_empty - missing;
+      if (slack < score) score = slack;
+    }
   }
-  len_words = len_words - squares_solved;
-  short int word[len_words];
-  uint index_unsolved_squares[len_words];
-  uint index = 0;
-  for (int i = 0; i < len_words + squares_solved; i++) {
-    bool is_solved = false;
-    for (int j = 0; j < squares_solved; j++) {
-      if (index_squares[j] == i) is_solved = true;
-    }
-    if (!is_solved) {
-      index_unsolved_squares[index] = i;
-      index++;
-    }
-  }
-  int numword = pow2(len_words);
-  for (int i = 0; i < numword; i++) {
-    genWord(i, len_words, word);
-    fill_game(g, word, index_unsolved_squares, len_words);
-    if (game_won(g)) {
-      return true;
+  return score;
+}
+
+/* Index among the squares searched of the next square to decide, or -1 if
+they are all colored. In row-major order, that is the first EMPTY square after
+the last decision; otherwise, the EMPTY square with the lowest branch_score,
+the first one on ties. */
+int search_next_empty(const search* s) {
+  if (s->branching != BRANCH_ROW_MAJOR) {
+    int best = -1, best_score = 0;
+    for (int l = 0; l < s->nb_squares; l++) {
+      int k = s->squares != NULL ? s->squares[l] : l;
+      if (cell_color(s->g, k) != EMPTY) continue;
+      int score = branch_score(s, k);
+      if (best < 0 || score < best_score) {
+        best = l;
+        best_score = score;
+      }
     }
+    return best;
   }
-  return false;
+  int from = s->depth > 0 ? s->stack[s->depth - 1].index : 0;
+  if (s->squares == NULL) return bb_next_empty(s->g, from);
+  while (from < s->nb_squares && cell_color(s->g, s->squares[from]) != EMPTY)
+    from++;
+  return from < s->nb_squares ? from : -1;
 }
 
-uint game_nb_solutions(cgame g) {
+/* Checks the budgets of s before a new decision. The clock is only read every
+256 decisions. */
+bool search_out_of_budget(const search* s) {
+  const solve_opts* o = s->opts;
+  if (o == NULL) return false;
+  if (o->node_limit != 0 && s->nb_nodes >= o->node_limit) return true;
+  if (o->cancel != NULL && *o->cancel) return true;
+  return o->time_limit > 0 && (s->nb_nodes & 255) == 0 &&
+         solve_clock() - s->start >= o->time_limit;
+}
+
+/* Moves to the next solution, which g then holds. Returns false once the
+whole tree is explored, or when the budgets of the search run out, which then
+sets stopped. */
+bool search_next(search* s) {
+  game g = s->g;
+  if (s->on_solution) {
+    s->on_solution = false;
+    s->consistent = false;  // to backtrack
+  }
+  while (true) {
+    if (s->consistent) {
+      int k = search_next_empty(s);
+      if (k < 0) {
+        // No empty square left and no error: every constraint is satisfied.
+        s->on_solution = true;
+        return true;
+      }
+      if (search_out_of_budget(s)) {
+        s->stopped = true;
+        return false;
+      }
+      search_decide(s, k, WHITE, false);
+      continue;
+    }
+    // Backtracking to the last decision that still has a color to try.
+    while (s->depth > 0 && s->stack[s->depth - 1].last) {
+      undo_squares(g, s->index_squares, &s->solved_squares,
+                   s->stack[s->depth - 1].mark);
+      s->depth--;
+    }
+    if (s->depth == 0) return false;
+    decision* d = &s->stack[s->depth - 1];
+    undo_squares(g, s->index_squares, &s->solved_squares, d->mark);
+    s->depth--;
+    search_decide(s, d->index, BLACK, true);
+  }
+}
+
+/* Groups the EMPTY squares of g into components, two squares being in the
+same component when the window of a constraint holds them both: the squares
+of different components can then be colored independently. Fills squares with
+the EMPTY squares, component after component and each in row-major order, and
+starts[c] with the index of the first square of component c, starts[c + 1]
+being the end of it. Returns the number of components. */
+int empty_components(cgame g, int squares[], int starts[]) {
+  int size = g->height * g->width;
+  int* parents = malloc(size * sizeof(int));
+  int* components = malloc(size * sizeof(int));
+  if (parents == NULL || components == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  // Union-find over the squares, with path halving. The root of a component
+  // is its first square.
+  for (int k = 0; k < size; k++) parents[k] = k;
+  for (int q = 0; q < size; q++) {
+    if (cell_constraint(g, q) == UNCONSTRAINED) continue;
+    uint window_buffer[9];
+    int n;
+    const uint* window = game_neighbours(g, q, &n, window_buffer);
+    int root = -1;
+    for (int l = 0; l < n; l++) {
+      int k = window[l];
+      if (cell_color(g, k) != EMPTY) continue;
+      while (parents[k] != k) {
+        parents[k] = parents[parents[k]];
+        k = parents[k];
+      }
+      if (root < 0) {
+        root = k;
+      } else if (k < root) {
+        parents[root] = k;
+        root = k;
+      } else if (k > root) {
+        parents[k] = root;
+      }
+    }
+  }
+
+  // The components are numbered in the order of their first square, then the
+  // squares are sorted by component.
+  int nb_components = 0;
+  for (int k = 0; k < size; k++) {
+    if (cell_color(g, k) != EMPTY) continue;
+    int r = k;
+    while (parents[r] != r) r = parents[r];
+    components[k] = r == k ? nb_components++ : components[r];
+  }
+  for (int c = 0; c <= nb_components; c++) starts[c] = 0;
+  for (int k = 0; k < size; k++) {
+    if (cell_color(g, k) == EMPTY) starts[components[k] + 1]++;
+  }
+  for (int c = 0; c < nb_components; c++) starts[c + 1] += starts[c];
+  // parents is reused as the next free place of each component.
+  for (int c = 0; c < nb_components; c++) parents[c] = starts[c];
+  for (int k = 0; k < size; k++) {
+    if (cell_color(g, k) == EMPTY) squares[parents[components[k]]++] = k;
+  }
+  free(parents);
+  free(components);
+  return nb_components;
+}
+
+/* Searches g for its solutions one component at a time (see
+empty_components), and multiplies the numbers of solutions of the
+components. The search stops after limit solutions (0 means no limit); if it
+stops on a solution, g holds that solution. The options, which may be NULL,
+give the branching heuristic and the budgets of the search. When r is not
+NULL, it gets the outcome: TIMEOUT if a budget ran out, in which case the
+count is not meaningful, SOLVED if there is a solution and UNSAT otherwise. */
+uint search_game(game g, uint limit, const solve_opts* opts,
+                 solve_result* r) {
+  search s;
+  search_init(&s, g);
+  if (opts != NULL) s.branching = opts->branching;
+  s.opts = opts;
+  if (!s.consistent) {
+    if (r != NULL) *r = (solve_result){UNSAT, 0, solve_clock() - s.start};
+    search_free(&s);
+    return 0;
+  }
+  int size = g->height * g->width;
+  int* squares = malloc(size * sizeof(int));
+  int* starts = malloc((size + 1) * sizeof(int));
+  if (squares == NULL || starts == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  int nb_components = empty_components(g, squares, starts);
+  uint nb_solutions = 1;
+  for (int c = 0; c < nb_components && nb_solutions > 0; c++) {
+    // Once the limit is reached, the other components only need a solution.
+    uint component_limit = limit;
+    if (limit != 0 && nb_solutions >= limit) component_limit = 1;
+    search_focus(&s, squares + starts[c], starts[c + 1] - starts[c]);
+    uint n = 0;
+    while ((component_limit == 0 || n < component_limit) && search_next(&s))
+      n++;
+    if (s.stopped) break;
+    // A component left on a solution stays colored, which does not change the
+    // solutions of the others. Without a limit, the count saturates at
+    // UINT_MAX, as in game_nb_solutions.
+    uint64_t product = (uint64_t)nb_solutions * n;
+    if (limit != 0 && product > limit)
+      nb_solutions = limit;
+    else
+      nb_solutions = product > UINT_MAX ? UINT_MAX : product;
+  }
+  if (r != NULL) {
+    r->status = s.stopped ? TIMEOUT : nb_solutions > 0 ? SOLVED : UNSAT;
+    r->nb_nodes = s.nb_nodes;
+    r->time = solve_clock() - s.start;
+  }
+  free(squares);
+  free(starts);
+  search_free(&s);
+  return nb_solutions;
+}
+
+void game_get_status_map(cgame g, status map[]) {
+  for (uint i = 0; i < g->height; i++) {
+    for (uint j = 0; j < g->width; j++) {
+      map[i * g->width + j] = game_get_status(g, i, j);
+    }
+  }
+}
+
+/* The solvers index the squares with ints: larger games are rejected before
+any of their sizes is computed. */
+#define SOLVER_MAX_SQUARES ((size_t)INT_MAX)
+
+void solver_check(cgame g) {
+  if ((size_t)g->height * g->width > SOLVER_MAX_SQUARES) {
+    fprintf(stderr, "Game of %u x %u squares too large for the solver\n",
+            g->height, g->width);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* Copy of g with only its constraints: the solver ignores the colors already
+played. The copy gets the neighbourhood table, which g is left without. */
+game copy_constraints(cgame g) {
+  solver_check(g);
   game g2 = game_copy(g);
-  uint len_words = g->height * g->width;
-  int index_solved_squares[len_words];
-  int nb_solved = presolve_game(g2, index_solved_squares);
-  if (game_won(g2)) {
-    game_delete(g2);
-    return 1;
+  for (uint i = 0; i < g2->height; i++) {
+    for (uint j = 0; j < g2->width; j++) {
+      game_set_color(g2, i, j, EMPTY);
+    }
   }
-  short int word[len_words];
-  len_words -= nb_solved;
-  uint index_unsolved_squares[len_words];
+  game_neighbours_build(g2);
+  return g2;
+}
+
+bool game_solve(game g) {
+  solve_opts opts = {BRANCH_ROW_MAJOR};
+  return game_solve_opts(g, &opts);
+}
 
-  int index = 0;
+bool game_solve_opts(game g, const solve_opts* opts) {
+  return game_solve_ext(g, opts, NULL) == SOLVED;
+}
 
-  // Construction du tableau des cases non trouvées
-  for (int i = 0; i < len_words + nb_solved; i++) {
-    bool is_solved = false;
-    for (int j = 0; j < nb_solved; j++) {
-      if (index_solved_squares[j] == i) is_solved = true;
+solve_status game_solve_ext(game g, const solve_opts* opts, solve_result* r) {
+  game g2 = copy_constraints(g);
+  solve_result result;
+  search_game(g2, 1, opts, &result);
+  bool found = result.status == SOLVED;
+  if (found) {
+    game_restart(g);
+    for (uint i = 0; i < g->height; i++) {
+      for (uint j = 0; j < g->width; j++) {
+        game_set_color(g, i, j, game_get_color(g2, i, j));
+      }
     }
-    if (!is_solved) {
-      index_unsolved_squares[index] = i;
-      index++;
+  }
+  game_delete(g2);
+  if (r != NULL) *r = result;
+  return result.status;
+}
+
+/* Number of ints of the keys of a counter, after which its cache is emptied
+(128 MB). */
+#define COUNTER_MAX_KEYS ((size_t)1 << 25)
+
+/* A count of the cache of a counter, and the key of its residual problem. */
+typedef struct {
+  uint64_t hash;
+  size_t key;  // place of the key in the keys of the counter, 0 when unused
+  uint64_t count;
+} counter_entry;
+
+/* State of a count by search with component caching, as in sharpSAT: after
+each decision, the EMPTY squares are split into components (see
+empty_components), which are counted apart, and the count of each component is
+cached. The key of a component is its squares and the number of black squares
+still needed by each constraint that sees them, which is all its solutions
+depend on: two branches that leave the same residual problem only count it
+once. */
+typedef struct {
+  game g;
+  int* index_squares;  // the trail
+  int solved_squares;
+  // Scratch arrays over the squares, valid where stamps holds stamp.
+  uint* stamps;
+  uint stamp;
+  int* firsts;  // first square seen by a constraint, as a local index
+  // Cache: the keys one after the other, each preceded by its length.
+  int* keys;
+  size_t keys_size;
+  size_t keys_capacity;
+  counter_entry* entries;
+  size_t nb_entries;
+  size_t capacity;  // of entries, a power of 2
+} counter;
+
+uint64_t counter_add(uint64_t a, uint64_t b) {
+  return a > UINT64_MAX - b ? UINT64_MAX : a + b;
+}
+
+uint64_t counter_mul(uint64_t a, uint64_t b) {
+  if (a != 0 && b > UINT64_MAX / a) return UINT64_MAX;
+  return a * b;
+}
+
+void counter_init(counter* c, game g) {
+  int size = g->height * g->width;
+  c->g = g;
+  c->index_squares = malloc(size * sizeof(int));
+  c->stamps = calloc(size, sizeof(uint));
+  c->firsts = malloc(size * sizeof(int));
+  c->keys_capacity = 1024;
+  c->keys = malloc(c->keys_capacity * sizeof(int));
+  c->capacity = 1024;
+  c->entries = calloc(c->capacity, sizeof(counter_entry));
+  if (c->index_squares == NULL || c->stamps == NULL || c->firsts == NULL ||
+      c->keys == NULL || c->entries == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  c->solved_squares = 0;
+  c->stamp = 0;
+  c->keys_size = 1;  // so that 0 is not a key
+  c->nb_entries = 0;
+}
+
+void counter_free(counter* c) {
+  free(c->index_squares);
+  free(c->stamps);
+  free(c->firsts);
+  free(c->keys);
+  free(c->entries);
+}
+
+/* Starts a new use of the scratch arrays. */
+void counter_stamp(counter* c) {
+  c->stamp++;
+  if (c->stamp == 0) {
+    // After 2^32 uses, the old stamps could be taken for new ones.
+    memset(c->stamps, 0, c->g->height * c->g->width * sizeof(uint));
+    c->stamp = 1;
+  }
+}
+
+/* Place of the entry of the n ints of key in the cache, or of the free entry
+where it goes. */
+size_t counter_find(const counter* c, const int key[], int n, uint64_t hash) {
+  size_t e = hash & (c->capacity - 1);
+  while (c->entries[e].key != 0) {
+    const int* k = c->keys + c->entries[e].key;
+    if (c->entries[e].hash == hash && k[-1] == n &&
+        memcmp(k, key, n * sizeof(int)) == 0)
+      return e;
+    e = (e + 1) & (c->capacity - 1);
+  }
+  return e;
+}
+
+void counter_store(counter* c, const int key[], int n, uint64_t hash,
+                   uint64_t count) {
+  if (c->keys_size + n + 1 > COUNTER_MAX_KEYS) {
+    memset(c->entries, 0, c->capacity * sizeof(counter_entry));
+    c->nb_entries = 0;
+    c->keys_size = 1;
+  }
+  if (2 * (c->nb_entries + 1) > c->capacity) {
+    counter_entry* old = c->entries;
+    size_t old_capacity = c->capacity;
+    c->capacity *= 2;
+    c->entries = calloc(c->capacity, sizeof(counter_entry));
+    if (c->entries == NULL) {
+      fprintf(stderr, "Memory allocation failed");
+      exit(EXIT_FAILURE);
     }
+    for (size_t e = 0; e < old_capacity; e++) {
+      if (old[e].key == 0) continue;
+      size_t f = old[e].hash & (c->capacity - 1);
+      while (c->entries[f].key != 0) f = (f + 1) & (c->capacity - 1);
+      c->entries[f] = old[e];
+    }
+    free(old);
   }
-  int numword = pow2(len_words);
-  uint nb_solutions = 0;
-  for (int i = 0; i < numword; i++) {
-    genWord(i, len_words, word);
-    fill_game(g2, word, index_unsolved_squares, len_words);
-    if (game_won(g2)) {
-      nb_solutions++;
+  while (c->keys_size + n + 1 > c->keys_capacity) {
+    c->keys_capacity *= 2;
+    c->keys = realloc(c->keys, c->keys_capacity * sizeof(int));
+    if (c->keys == NULL) {
+      fprintf(stderr, "Memory allocation failed");
+      exit(EXIT_FAILURE);
+    }
+  }
+  c->keys[c->keys_size] = n;
+  memcpy(c->keys + c->keys_size + 1, key, n * sizeof(int));
+  size_t e = counter_find(c, key, n, hash);
+  c->entries[e] = (counter_entry){hash, c->keys_size + 1, count};
+  c->keys_size += n + 1;
+  c->nb_entries++;
+}
+
+/* Splits the EMPTY squares among the n squares of squares, in row-major
+order, into components, as empty_components does for the whole grid. Fills
+components with them, component after component, and starts with the bounds
+of each. Returns the number of components. */
+int counter_split(counter* c, const int squares[], int n, int components[],
+                  int starts[]) {
+  game g = c->g;
+  int* empty = malloc((n + 1) * sizeof(int));
+  int* parents = malloc((n + 1) * sizeof(int));
+  int* ids = malloc((n + 1) * sizeof(int));
+  if (empty == NULL || parents == NULL || ids == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  int m = 0;
+  for (int l = 0; l < n; l++) {
+    if (cell_color(g, squares[l]) == EMPTY) empty[m++] = squares[l];
+  }
+  // Union-find over the EMPTY squares, through the constraints that see them.
+  // The root of a component is its first square.
+  counter_stamp(c);
+  for (int a = 0; a < m; a++) {
+    parents[a] = a;
+    uint window_buffer[9];
+    int nb;
+    const uint* window = game_neighbours(g, empty[a], &nb, window_buffer);
+    for (int l = 0; l < nb; l++) {
+      int q = window[l];
+      if (cell_constraint(g, q) == UNCONSTRAINED) continue;
+      if (c->stamps[q] != c->stamp) {
+        c->stamps[q] = c->stamp;
+        c->firsts[q] = a;
+        continue;
+      }
+      int r1 = a, r2 = c->firsts[q];
+      while (parents[r1] != r1) {
+        parents[r1] = parents[parents[r1]];
+        r1 = parents[r1];
+      }
+      while (parents[r2] != r2) {
+        parents[r2] = parents[parents[r2]];
+        r2 = parents[r2];
+      }
+      if (r1 < r2)
+        parents[r2] = r1;
+      else if (r2 < r1)
+        parents[r1] = r2;
+    }
+  }
+  int nb_components = 0;
+  for (int a = 0; a < m; a++) {
+    int r = a;
+    while (parents[r] != r) r = parents[r];
+    ids[a] = r == a ? nb_components++ : ids[r];
+  }
+  for (int k = 0; k <= nb_components; k++) starts[k] = 0;
+  for (int a = 0; a < m; a++) starts[ids[a] + 1]++;
+  for (int k = 0; k < nb_components; k++) starts[k + 1] += starts[k];
+  // parents is reused as the next free place of each component.
+  for (int k = 0; k < nb_components; k++) parents[k] = starts[k];
+  for (int a = 0; a < m; a++) components[parents[ids[a]]++] = empty[a];
+  free(empty);
+  free(parents);
+  free(ids);
+  return nb_components;
+}
+
+/* Components of at most this many squares are counted by brute force. */
+#define COUNTER_BITSLICE_SQUARES 12
+
+/* Counts the solutions of a component of n EMPTY squares by trying all the
+2^n colorings, 64 at a time: bit b of a word stands for coloring number
+64 * x + b, where square l is black if bit l of that number is set. The
+black squares of each constraint are summed for the 64 colorings at once by a
+4-bit adder whose bits are words, and compared with the number the constraint
+still needs. */
+uint64_t counter_bitslice(counter* c, const int squares[], int n) {
+  game g = c->g;
+  // The constraints that see the component and their squares, as indexes in
+  // squares, once per time they appear in the window.
+  int nb_constraints = 0;
+  int* missing = malloc(9 * n * sizeof(int));
+  int* windows = malloc(9 * n * 9 * sizeof(int));
+  int* sizes = malloc(9 * n * sizeof(int));
+  if (missing == NULL || windows == NULL || sizes == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  // Every EMPTY square of these windows is in the component.
+  for (int l = 0; l < n; l++) c->firsts[squares[l]] = l;
+  counter_stamp(c);
+  for (int l = 0; l < n; l++) {
+    uint window_buffer[9];
+    int nb;
+    const uint* window = game_neighbours(g, squares[l], &nb, window_buffer);
+    for (int m = 0; m < nb; m++) {
+      int q = window[m];
+      if (cell_constraint(g, q) == UNCONSTRAINED || c->stamps[q] == c->stamp)
+        continue;
+      c->stamps[q] = c->stamp;
+      uint around_buffer[9];
+      int nb_around;
+      const uint* around = game_neighbours(g, q, &nb_around, around_buffer);
+      int size = 0, nb_black = 0;
+      for (int a = 0; a < nb_around; a++) {
+        if (cell_color(g, around[a]) == EMPTY)
+          windows[9 * nb_constraints + size++] = c->firsts[around[a]];
+        else if (cell_color(g, around[a]) == BLACK)
+          nb_black++;
+      }
+      missing[nb_constraints] = cell_constraint(g, q) - nb_black;
+      sizes[nb_constraints] = size;
+      nb_constraints++;
+    }
+  }
+
+  // Squares 0 to 5 vary inside a word, the others from word to word.
+  static const uint64_t lanes[6] = {
+      0xAAAAAAAAAAAAAAAAu, 0xCCCCCCCCCCCCCCCCu, 0xF0F0F0F0F0F0F0F0u,
+      0xFF00FF00FF00FF00u, 0xFFFF0000FFFF0000u, 0xFFFFFFFF00000000u};
+  uint64_t colorings[COUNTER_BITSLICE_SQUARES];
+  for (int l = 0; l < n && l < 6; l++) colorings[l] = lanes[l];
+  uint64_t valid = n >= 6 ? ~(uint64_t)0 : ((uint64_t)1 << (1 << n)) - 1;
+  uint64_t count = 0;
+  for (uint64_t x = 0; x < ((uint64_t)1 << (n > 6 ? n - 6 : 0)); x++) {
+    for (int l = 6; l < n; l++)
+      colorings[l] = (x >> (l - 6)) & 1 ? ~(uint64_t)0 : 0;
+    uint64_t ok = valid;
+    for (int k = 0; k < nb_constraints && ok != 0; k++) {
+      // sum = (s3 s2 s1 s0), at most 9.
+      uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+      for (int a = 0; a < sizes[k]; a++) {
+        uint64_t carry = colorings[windows[9 * k + a]];
+        uint64_t t = s0 & carry;
+        s0 ^= carry;
+        carry = t;
+        t = s1 & carry;
+        s1 ^= carry;
+        carry = t;
+        t = s2 & carry;
+        s2 ^= carry;
+        s3 |= t;
+      }
+      int m = missing[k];
+      ok &= (m & 1 ? s0 : ~s0) & (m & 2 ? s1 : ~s1) & (m & 4 ? s2 : ~s2) &
+            (m & 8 ? s3 : ~s3);
     }
+    count += __builtin_popcountll(ok);
   }
+  free(missing);
+  free(windows);
+  free(sizes);
+  return count;
+}
+
+uint64_t counter_count_squares(counter* c, const int squares[], int n);
+
+/* Counts the solutions of a component of n EMPTY squares, in row-major
+order. */
+uint64_t counter_count_component(counter* c, const int squares[], int n) {
+  game g = c->g;
+  // The key: the squares, then the black squares still needed by each
+  // constraint that sees them.
+  int* key = malloc((1 + 10 * n) * sizeof(int));
+  if (key == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  int size = 0;
+  key[size++] = n;
+  for (int l = 0; l < n; l++) key[size++] = squares[l];
+  counter_stamp(c);
+  for (int l = 0; l < n; l++) {
+    uint window_buffer[9];
+    int nb;
+    const uint* window = game_neighbours(g, squares[l], &nb, window_buffer);
+    for (int m = 0; m < nb; m++) {
+      int q = window[m];
+      if (cell_constraint(g, q) == UNCONSTRAINED || c->stamps[q] == c->stamp)
+        continue;
+      c->stamps[q] = c->stamp;
+      int nb_squares, nb_black, nb_decided;
+      bb_window(g, q / g->width, q % g->width, &nb_squares, &nb_black,
+                &nb_decided);
+      key[size++] = cell_constraint(g, q) - nb_black;
+    }
+  }
+  // A square seen by no constraint takes any color.
+  if (n == 1 && size == 2) {
+    free(key);
+    return 2;
+  }
+
+  uint64_t hash = 14695981039346656037u;  // FNV-1a
+  for (int l = 0; l < size; l++) {
+    hash = (hash ^ (uint)key[l]) * 1099511628211u;
+  }
+  size_t e = counter_find(c, key, size, hash);
+  if (c->entries[e].key != 0) {
+    free(key);
+    return c->entries[e].count;
+  }
+
+  uint64_t count = 0;
+  if (n <= COUNTER_BITSLICE_SQUARES) {
+    count = counter_bitslice(c, squares, n);
+    counter_store(c, key, size, hash, count);
+    free(key);
+    return count;
+  }
+  for (color col = WHITE; col <= BLACK; col++) {
+    int mark = c->solved_squares;
+    if (decide_square(g, squares[0], col, c->index_squares, &c->solved_squares,
+                      NULL))
+      count = counter_add(count, counter_count_squares(c, squares + 1, n - 1));
+    undo_squares(g, c->index_squares, &c->solved_squares, mark);
+  }
+  counter_store(c, key, size, hash, count);
+  free(key);
+  return count;
+}
+
+/* Counts the ways to color the EMPTY squares among the n squares of squares,
+in row-major order, which must be all the EMPTY squares of the constraints
+that see them. */
+uint64_t counter_count_squares(counter* c, const int squares[], int n) {
+  int* components = malloc((n + 1) * sizeof(int));
+  int* starts = malloc((n + 2) * sizeof(int));
+  if (components == NULL || starts == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  int nb_components = counter_split(c, squares, n, components, starts);
+  uint64_t count = 1;
+  for (int k = 0; k < nb_components && count > 0; k++) {
+    count = counter_mul(
+        count, counter_count_component(c, components + starts[k],
+                                       starts[k + 1] - starts[k]));
+  }
+  free(components);
+  free(starts);
+  return count;
+}
+
+uint game_nb_solutions(cgame g) {
+  game g2 = copy_constraints(g);
+  counter c;
+  counter_init(&c, g2);
+  uint64_t count = 0;
+  if (presolve_game(g2, c.index_squares, &c.solved_squares)) {
+    int size = g2->height * g2->width;
+    int* squares = malloc(size * sizeof(int));
+    if (squares == NULL) {
+      fprintf(stderr, "Memory allocation failed");
+      exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < size; k++) squares[k] = k;
+    count = counter_count_squares(&c, squares, size);
+    free(squares);
+  }
+  counter_free(&c);
+  game_delete(g2);
+  return count > UINT_MAX ? UINT_MAX : count;
+}
+
+uint game_foreach_solution(cgame g, solution_callback callback, void* ctx) {
+  game g2 = copy_constraints(g);
+  search s;
+  search_init(&s, g2);
+  uint nb_solutions = 0;
+  // A single buffer is given to the callback: nothing is kept from one
+  // solution to the next.
+  uint size = g2->height * g2->width;
+  color* colors = malloc(size * sizeof(color));
+  if (colors == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  while (search_next(&s)) {
+    nb_solutions++;
+    for (uint k = 0; k < size; k++) colors[k] = cell_color(g2, k);
+    if (!callback(colors, ctx)) break;
+  }
+  free(colors);
+  search_free(&s);
+  game_delete(g2);
+  return nb_solutions;
+}
+
+uint game_nb_solutions_upto(cgame g, uint limit) {
+  game g2 = copy_constraints(g);
+  uint nb_solutions = search_game(g2, limit, NULL, NULL);
   game_delete(g2);
   return nb_solutions;
 }
+
+bool game_has_unique_solution(cgame g) {
+  // No need to look further than a second solution.
+  return game_nb_solutions_upto(g, 2) == 1;
+}
+
+/* Adds to f the clauses saying that exactly n of the m variables of vars are
+true, as a sequential counter: s[i][j] is true when at least j of the first i
+variables are, for j up to n + 1. A variable may appear several times in vars,
+it is then counted as many times. */
+void cnf_add_exactly(cnf* f, const int vars[], int m, int n) {
+  if (n < 0 || n > m) {
+    cnf_add_clause(f, NULL, 0);
+    return;
+  }
+  // s[i][0] is true and s[i][j] false for j > i. Only the variables of the
+  // counter are read, which the compiler cannot see: the table is zeroed.
+  int s[10][11] = {{0}};
+  for (int i = 1; i <= m; i++) {
+    int x = vars[i - 1];
+    for (int j = 1; j <= i && j <= n + 1; j++) {
+      s[i][j] = cnf_new_var(f);
+      // s[i-1][j] or (x and s[i-1][j-1]) implies s[i][j], and conversely.
+      if (j <= i - 1) cnf_add_clause(f, (int[]){-s[i - 1][j], s[i][j]}, 2);
+      if (j == 1)
+        cnf_add_clause(f, (int[]){-x, s[i][j]}, 2);
+      else
+        cnf_add_clause(f, (int[]){-x, -s[i - 1][j - 1], s[i][j]}, 3);
+      if (j <= i - 1)
+        cnf_add_clause(f, (int[]){-s[i][j], s[i - 1][j], x}, 3);
+      else
+        cnf_add_clause(f, (int[]){-s[i][j], x}, 2);
+      if (j > 1 && j <= i - 1)
+        cnf_add_clause(f, (int[]){-s[i][j], s[i - 1][j], s[i - 1][j - 1]}, 3);
+      else if (j > 1)
+        cnf_add_clause(f, (int[]){-s[i][j], s[i - 1][j - 1]}, 2);
+    }
+  }
+  if (n >= 1) cnf_add_clause(f, (int[]){s[m][n]}, 1);
+  if (n + 1 <= m) cnf_add_clause(f, (int[]){-s[m][n + 1]}, 1);
+}
+
+/* Encodes the constraints of g: variable k+1 is true when the square of
+row-major index k is black. */
+void game_cnf(cgame g, cnf* f) {
+  solver_check(g);
+  uint size = g->height * g->width;
+  cnf_init(f);
+  for (uint k = 0; k < size; k++) cnf_new_var(f);
+  for (uint k = 0; k < size; k++) {
+    if (cell_constraint(g, k) == UNCONSTRAINED) continue;
+    uint squares_buffer[9];
+    int n;
+    const uint* squares = game_neighbours(g, k, &n, squares_buffer);
+    int vars[9];
+    for (int l = 0; l < n; l++) vars[l] = squares[l] + 1;
+    cnf_add_exactly(f, vars, n, cell_constraint(g, k));
+  }
+}
+
+void game_save_cnf(cgame g, char* filename) {
+  solver_check(g);
+  FILE* fp = fopen(filename, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "Cannot open %s\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  cnf f;
+  game_cnf(g, &f);
+  fprintf(fp, "c mosaic %u x %u: variable %u * i + j + 1 is square (i,j)\n",
+          g->height, g->width, g->width);
+  cnf_print(&f, fp);
+  cnf_free(&f);
+  fclose(fp);
+}
+
+bool game_solve_sat(game g) {
+  uint size = g->height * g->width;
+  cnf f;
+  game_cnf(g, &f);
+  bool* model = malloc(f.nb_vars * sizeof(bool) + 1);
+  if (model == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  bool found = cnf_solve(&f, model);
+  if (found) {
+    game_restart(g);
+    for (uint k = 0; k < size; k++)
+      game_set_color(g, k / g->width, k % g->width, model[k] ? BLACK : WHITE);
+  }
+  free(model);
+  cnf_free(&f);
+  return found;
+}
+
+/* game_nb_solutions_mt splits the search tree into tasks, each being the
+decisions leading to a subtree, whose solutions are counted as by
+game_nb_solutions. Every worker has its own deque of tasks and its own
+counter, whose cache serves all its tasks: it takes the most recent task of
+its own, and when it has none left, steals the oldest task of another worker,
+the one likely to have the biggest subtree. */
+
+typedef struct {
+  int nb_moves;
+  int* moves;  // square * 2 + 1 for BLACK, + 0 for WHITE
+} task;
+
+typedef struct {
+  task* tasks;
+  int first;  // oldest task
+  int size;
+  int capacity;
+} task_deque;
+
+typedef struct pool_s pool;
+
+typedef struct {
+  pool* p;
+  unsigned id;
+  game g;
+  uint64_t nb_solutions;
+} worker;
+
+struct pool_s {
+  pthread_mutex_t lock;
+  unsigned nb_workers;
+  task_deque* deques;
+};
+void pool_push(pool* p, unsigned id, task t) {
+  task_deque* d = &p->deques[id];
+  if (d->size == d->capacity) {
+    task* tasks = malloc(2 * d->capacity * sizeof(task));
+    if (tasks == NULL) {
+      fprintf(stderr, "Memory allocation failed");
+      exit(EXIT_FAILURE);
+    }
+    for (int k = 0; k < d->size; k++)
+      tasks[k] = d->tasks[(d->first + k) % d->capacity];
+    free(d->tasks);
+    d->tasks = tasks;
+    d->first = 0;
+    d->capacity *= 2;
+  }
+  d->tasks[(d->first + d->size) % d->capacity] = t;
+  d->size++;
+}
+
+/* Task made of the decisions of s up to depth, the one at depth being played
+with color c. */
+task search_task(const search* s, int depth, color c) {
+  task t;
+  t.nb_moves = depth + 1;
+  t.moves = malloc((depth + 1) * sizeof(int));
+  if (t.moves == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  for (int m = 0; m <= depth; m++) {
+    color c2 = m < depth ? s->stack[m].c : c;
+    t.moves[m] = 2 * s->stack[m].square + (c2 == BLACK ? 1 : 0);
+  }
+  return t;
+}
+
+/* Takes the next task of worker id. Returns false once there is none left. */
+bool pool_take(pool* p, unsigned id, task* t) {
+  pthread_mutex_lock(&p->lock);
+  bool found = true;
+  task_deque* own = &p->deques[id];
+  if (own->size > 0) {
+    own->size--;
+    *t = own->tasks[(own->first + own->size) % own->capacity];
+  } else {
+    found = false;
+    for (unsigned k = 1; k < p->nb_workers && !found; k++) {
+      task_deque* victim = &p->deques[(id + k) % p->nb_workers];
+      if (victim->size > 0) {
+        *t = victim->tasks[victim->first];
+        victim->first = (victim->first + 1) % victim->capacity;
+        victim->size--;
+        found = true;
+      }
+    }
+  }
+  pthread_mutex_unlock(&p->lock);
+  return found;
+}
+
+void* pool_work(void* ctx) {
+  worker* w = ctx;
+  game g = w->g;
+  int size = g->height * g->width;
+  counter c;
+  counter_init(&c, g);
+  int* squares = malloc(size * sizeof(int));
+  if (squares == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  for (int k = 0; k < size; k++) squares[k] = k;
+  bool presolved = presolve_game(g, c.index_squares, &c.solved_squares);
+  int base = c.solved_squares;
+  task t;
+  while (pool_take(w->p, w->id, &t)) {
+    undo_squares(g, c.index_squares, &c.solved_squares, base);
+    bool consistent = presolved;
+    for (int m = 0; m < t.nb_moves && consistent; m++)
+      consistent =
+          decide_square(g, t.moves[m] >> 1, t.moves[m] & 1 ? BLACK : WHITE,
+                        c.index_squares, &c.solved_squares, NULL);
+    free(t.moves);
+    if (consistent)
+      w->nb_solutions = counter_add(w->nb_solutions,
+                                    counter_count_squares(&c, squares, size));
+  }
+  free(squares);
+  counter_free(&c);
+  return NULL;
+}
+
+/* Splits the subtree of s into the tasks of its decisions nb_levels deep,
+dealt in turn to the workers of p from *id. */
+void pool_split(pool* p, search* s, int nb_levels, unsigned* id) {
+  int from = s->depth > 0 ? s->stack[s->depth - 1].square : 0;
+  int k = bb_next_empty(s->g, from);
+  if (nb_levels == 0 || k < 0) {
+    task t = {0, NULL};
+    if (s->depth > 0)
+      t = search_task(s, s->depth - 1, s->stack[s->depth - 1].c);
+    pool_push(p, *id, t);
+    *id = (*id + 1) % p->nb_workers;
+    return;
+  }
+  for (int c = 0; c < 2; c++) {
+    int mark = s->solved_squares;
+    search_decide(s, k, c == 0 ? WHITE : BLACK, true);
+    if (s->consistent) pool_split(p, s, nb_levels - 1, id);
+    undo_squares(s->g, s->index_squares, &s->solved_squares, mark);
+    s->depth--;
+  }
+}
+
+uint game_nb_solutions_mt(cgame g, unsigned nthreads) {
+  if (nthreads <= 1) return game_nb_solutions(g);
+  pool p;
+  pthread_mutex_init(&p.lock, NULL);
+  p.nb_workers = nthreads;
+  p.deques = malloc(nthreads * sizeof(task_deque));
+  worker* workers = malloc(nthreads * sizeof(worker));
+  pthread_t* threads = malloc(nthreads * sizeof(pthread_t));
+  if (p.deques == NULL || workers == NULL || threads == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  for (unsigned id = 0; id < nthreads; id++) {
+    p.deques[id].tasks = malloc(16 * sizeof(task));
+    if (p.deques[id].tasks == NULL) {
+      fprintf(stderr, "Memory allocation failed");
+      exit(EXIT_FAILURE);
+    }
+    p.deques[id].first = 0;
+    p.deques[id].size = 0;
+    p.deques[id].capacity = 16;
+    workers[id] = (worker){&p, id, copy_constraints(g), 0};
+  }
+
+  // About 32 tasks per worker, from the first undecided squares after
+  // presolve_game, for the steals to even out subtrees of unequal sizes.
+  game g2 = copy_constraints(g);
+  search s;
+  search_init(&s, g2);
+  int nb_levels = 5;
+  while ((1u << nb_levels) < 32 * nthreads && nb_levels < 20) nb_levels++;
+  unsigned next = 0;
+  if (s.consistent) pool_split(&p, &s, nb_levels, &next);
+  search_free(&s);
+  game_delete(g2);
+
+  for (unsigned id = 0; id < nthreads; id++) {
+    if (pthread_create(&threads[id], NULL, pool_work, &workers[id]) != 0) {
+      fprintf(stderr, "Thread creation failed");
+      exit(EXIT_FAILURE);
+    }
+  }
+  uint64_t nb_solutions = 0;
+  for (unsigned id = 0; id < nthreads; id++) {
+    pthread_join(threads[id], NULL);
+    nb_solutions = counter_add(nb_solutions, workers[id].nb_solutions);
+    game_delete(workers[id].g);
+    free(p.deques[id].tasks);
+  }
+  free(p.deques);
+  free(workers);
+  free(threads);
+  pthread_mutex_destroy(&p.lock);
+  return nb_solutions > UINT_MAX ? UINT_MAX : nb_solutions;
+}
+
+/* game_nb_solutions_dp colors the squares one at a time, along the longer
+side of the grid. Whatever the colors already chosen, the rest of the grid
+only depends on how many black squares each constraint whose window is partly
+colored (an open constraint) still needs, its residual: colorings with the same
+residuals are merged and counted together. The residuals are stored 4 bits
+each, in a slot given to the constraint while it is open. */
+
+// Most constraints open at once, beyond which game_nb_solutions is used.
+#define DP_MAX_SLOTS 128
+
+/* Hash table from the residuals to the number of colorings leading to them.
+The states are stored one after the other, so that they can be walked through
+in their number rather than in the size of the table, and index is an open
+addressing table of state numbers plus one, 0 for a free place. */
+typedef struct {
+  uint key_words;    // words of a key
+  uint64_t* keys;    // key_words words for each state
+  uint64_t* counts;  // number of colorings for each state
+  size_t* places;    // place of each state in index
+  size_t size;
+  size_t* index;
+  size_t capacity;  // of index, always a power of two
+} dp_map;
+
+void dp_map_init(dp_map* map, uint key_words, size_t capacity) {
+  map->key_words = key_words;
+  map->keys = malloc(capacity / 2 * key_words * sizeof(uint64_t));
+  map->counts = malloc(capacity / 2 * sizeof(uint64_t));
+  map->places = malloc(capacity / 2 * sizeof(size_t));
+  map->index = calloc(capacity, sizeof(size_t));
+  if (map->keys == NULL || map->counts == NULL || map->places == NULL ||
+      map->index == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  map->size = 0;
+  map->capacity = capacity;
+}
+
+void dp_map_free(dp_map* map) {
+  free(map->keys);
+  free(map->counts);
+  free(map->places);
+  free(map->index);
+}
+
+void dp_map_clear(dp_map* map) {
+  for (size_t k = 0; k < map->size; k++) map->index[map->places[k]] = 0;
+  map->size = 0;
+}
+
+size_t dp_hash(const uint64_t* key, uint key_words) {
+  uint64_t h = 0;
+  for (uint w = 0; w < key_words; w++) {
+    h = (h ^ key[w]) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+  }
+  return (size_t)h;
+}
+
+// Counts can be huge on large grids: they saturate instead of wrapping around.
+uint64_t dp_add_counts(uint64_t a, uint64_t b) {
+  return a + b < a ? UINT64_MAX : a + b;
+}
+
+void dp_map_add(dp_map* map, const uint64_t* key, uint64_t count) {
+  uint key_words = map->key_words;
+  if (2 * (map->size + 1) > map->capacity) {
+    dp_map bigger;
+    dp_map_init(&bigger, key_words, 2 * map->capacity);
+    for (size_t k = 0; k < map->size; k++)
+      dp_map_add(&bigger, map->keys + k * key_words, map->counts[k]);
+    dp_map_free(map);
+    *map = bigger;
+  }
+  size_t place = dp_hash(key, key_words) & (map->capacity - 1);
+  while (map->index[place] != 0) {
+    size_t k = map->index[place] - 1;
+    if (memcmp(map->keys + k * key_words, key, key_words * sizeof(uint64_t)) ==
+        0) {
+      map->counts[k] = dp_add_counts(map->counts[k], count);
+      return;
+    }
+    place = (place + 1) & (map->capacity - 1);
+  }
+  size_t k = map->size++;
+  memcpy(map->keys + k * key_words, key, key_words * sizeof(uint64_t));
+  map->counts[k] = count;
+  map->places[k] = place;
+  map->index[place] = k + 1;
+}
+
+uint dp_get_residual(const uint64_t* key, uint slot) {
+  return (key[slot >> 4] >> (4 * (slot & 15))) & 15;
+}
+
+void dp_set_residual(uint64_t* key, uint slot, uint residual) {
+  uint shift = 4 * (slot & 15);
+  key[slot >> 4] = (key[slot >> 4] & ~((uint64_t)15 << shift)) |
+                   (uint64_t)residual << shift;
+}
+
+/* Position of square (i,j) in the order the squares are colored. */
+uint dp_position(cgame g, bool by_columns, uint i, uint j) {
+  return by_columns ? j * g->height + i : i * g->width + j;
+}
+
+/* An open constraint whose window contains the square being colored: the
+number of times it contains it, and the number of squares of the window that
+remain to be colored after it. */
+typedef struct {
+  uint slot;
+  uint nb_times;
+  uint nb_remaining;
+} dp_touch;
+
+uint game_nb_solutions_dp(cgame g) {
+  solver_check(g);
+  uint height = g->height;
+  uint width = g->width;
+  uint size = height * width;
+  bool by_columns = height < width;
+
+  // Positions where the window of each constraint starts and ends, and the
+  // constraints sorted by start and by end.
+  uint* first = malloc(size * sizeof(uint));
+  uint* last = malloc(size * sizeof(uint));
+  uint* nb_opening = calloc(size + 1, sizeof(uint));
+  uint* nb_closing = calloc(size + 1, sizeof(uint));
+  uint* opening = malloc(size * sizeof(uint));
+  uint* closing = malloc(size * sizeof(uint));
+  int* slots = malloc(size * sizeof(int));
+  uint* free_slots = malloc(size * sizeof(uint));
+  if (first == NULL || last == NULL || nb_opening == NULL ||
+      nb_closing == NULL || opening == NULL || closing == NULL ||
+      slots == NULL || free_slots == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  // A constraint with an empty neighbourhood is never open, it can only be 0.
+  bool unsatisfiable = false;
+  for (uint q = 0; q < size; q++) {
+    slots[q] = -1;
+    first[q] = UINT_MAX;
+    if (cell_constraint(g, q) == UNCONSTRAINED) continue;
+    uint squares_buffer[9];
+    int n;
+    const uint* squares = game_neighbours(g, q, &n, squares_buffer);
+    if (n == 0) {
+      unsatisfiable |= cell_constraint(g, q) != 0;
+      continue;
+    }
+    last[q] = 0;
+    for (int k = 0; k < n; k++) {
+      uint p = dp_position(g, by_columns, squares[k] / width,
+                           squares[k] % width);
+      if (p < first[q]) first[q] = p;
+      if (p > last[q]) last[q] = p;
+    }
+    nb_opening[first[q] + 1]++;
+    nb_closing[last[q] + 1]++;
+  }
+  // nb_opening[p] becomes the index of the first constraint opening at p.
+  for (uint p = 0; p < size; p++) {
+    nb_opening[p + 1] += nb_opening[p];
+    nb_closing[p + 1] += nb_closing[p];
+  }
+  for (uint q = 0; q < size; q++) {
+    if (first[q] == UINT_MAX) continue;
+    opening[nb_opening[first[q]]++] = q;
+    closing[nb_closing[last[q]]++] = q;
+  }
+  for (uint p = size; p > 0; p--) {
+    nb_opening[p] = nb_opening[p - 1];
+    nb_closing[p] = nb_closing[p - 1];
+  }
+  nb_opening[0] = nb_closing[0] = 0;
+
+  // A slot is given back when its constraint closes, so that two constraints
+  // open at the same time never share one.
+  uint nb_slots = 0, nb_free = 0;
+  for (uint p = 0; p < size; p++) {
+    for (uint k = nb_opening[p]; k < nb_opening[p + 1]; k++)
+      slots[opening[k]] = nb_free > 0 ? free_slots[--nb_free] : nb_slots++;
+    for (uint k = nb_closing[p]; k < nb_closing[p + 1]; k++)
+      free_slots[nb_free++] = slots[closing[k]];
+  }
+  free(free_slots);
+  if (unsatisfiable || nb_slots > DP_MAX_SLOTS) {
+    free(first);
+    free(last);
+    free(nb_opening);
+    free(nb_closing);
+    free(opening);
+    free(closing);
+    free(slots);
+    return unsatisfiable ? 0 : game_nb_solutions(g);
+  }
+
+  uint key_words = nb_slots / 16 + 1;
+  uint64_t key[DP_MAX_SLOTS / 16 + 1], next_key[DP_MAX_SLOTS / 16 + 1];
+  dp_map current, next;
+  dp_map_init(&current, key_words, 1024);
+  dp_map_init(&next, key_words, 1024);
+  memset(key, 0, sizeof(key));
+  dp_map_add(&current, key, 1);
+  for (uint p = 0; p < size && current.size > 0; p++) {
+    uint i = by_columns ? p % height : p / width;
+    uint j = by_columns ? p / height : p % width;
+    // The constraints seeing (i,j) are the squares of its neighbourhood.
+    dp_touch touches[9];
+    int nb_touches = 0;
+    uint squares_buffer[9];
+    int n;
+    const uint* squares = game_neighbours(g, i * width + j, &n, squares_buffer);
+    for (int k = 0; k < n; k++) {
+      uint q = squares[k];
+      if (slots[q] < 0) continue;
+      int t = 0;
+      while (t < nb_touches && touches[t].slot != (uint)slots[q]) t++;
+      if (t == nb_touches) {
+        uint window_buffer[9];
+        int m;
+        const uint* window = game_neighbours(g, q, &m, window_buffer);
+        touches[t].slot = slots[q];
+        touches[t].nb_times = 0;
+        touches[t].nb_remaining = 0;
+        for (int l = 0; l < m; l++) {
+          if (dp_position(g, by_columns, window[l] / width,
+                          window[l] % width) > p)
+            touches[t].nb_remaining++;
+        }
+        nb_touches++;
+      }
+      touches[t].nb_times++;
+    }
+
+    for (size_t s = 0; s < current.size; s++) {
+      memcpy(key, current.keys + s * key_words, key_words * sizeof(uint64_t));
+      for (uint k = nb_opening[p]; k < nb_opening[p + 1]; k++) {
+        uint q = opening[k];
+        dp_set_residual(key, slots[q], cell_constraint(g, q) > 15
+                                           ? 15
+                                           : (uint)cell_constraint(g, q));
+      }
+      for (int black = 0; black <= 1; black++) {
+        memcpy(next_key, key, key_words * sizeof(uint64_t));
+        bool ok = true;
+        for (int t = 0; ok && t < nb_touches; t++) {
+          int residual = dp_get_residual(next_key, touches[t].slot);
+          if (black) residual -= touches[t].nb_times;
+          ok = (residual >= 0 && (uint)residual <= touches[t].nb_remaining);
+          // A closing constraint is left at 0, like a free slot.
+          if (ok) dp_set_residual(next_key, touches[t].slot, residual);
+        }
+        if (ok) dp_map_add(&next, next_key, current.counts[s]);
+      }
+    }
+    dp_map tmp = current;
+    current = next;
+    next = tmp;
+    dp_map_clear(&next);
+  }
+
+  // Every constraint is closed at the end: only the state where they are all
+  // satisfied is left.
+  uint64_t nb_solutions = 0;
+  for (size_t s = 0; s < current.size; s++)
+    nb_solutions = dp_add_counts(nb_solutions, current.counts[s]);
+  dp_map_free(&current);
+  dp_map_free(&next);
+  free(first);
+  free(last);
+  free(nb_opening);
+  free(nb_closing);
+  free(opening);
+  free(closing);
+  free(slots);
+  return nb_solutions > UINT_MAX ? UINT_MAX : nb_solutions;
+}
@@ -20,12 +20,28 @@
 
 /**
  * @brief Creates a game by loading its description from a text file.
- * @details See the file format description in @ref index.
+ * @details See the file format description in @ref index. The lines may end
+ * with "\r\n", and the last one with no newline. The file is read in one
+ * pass, its squares written straight into the game.
  * @param filename input file
- * @return the loaded game
+ * @return the loaded game, or NULL if the file cannot be read or is malformed;
+ * the reason is then printed on stderr, after the line and column of the first
+ * error (filename:line:column: message)
  **/
 game game_load(char* filename);
 
+/**
+ * @brief Creates a game from its description in the text format, in memory.
+ * @details Same as @ref game_load on a file holding the @p size bytes of
+ * @p buffer, which need not end with a null character.
+ * @param buffer the text of the game
+ * @param size number of bytes of the text
+ * @return the loaded game, or NULL if the text is malformed; the reason is then
+ * printed on stderr, after the line and column of the first error
+ * (line:column: message)
+ **/
+game game_load_from_buffer(const char* buffer, size_t size);
+
 /**
  * @brief Saves a game in a text file.
  * @details See the file format description in @ref index.
@@ -34,23 +50,256 @@ game game_load(char* filename);
  **/
 void game_save(cgame g, char* filename);
 
+/**
+ * @brief Writes a game in the text format, in memory.
+ * @details The text is that of @ref game_save, with no null character at the
+ * end. It is written only if it fits in @p size bytes: the size needed is
+ * queried with a NULL @p buffer.
+ * @param g game to save
+ * @param buffer output buffer, or NULL
+ * @param size number of bytes of @p buffer
+ * @return the size of the text, written or not
+ **/
+size_t game_save_to_buffer(cgame g, char* buffer, size_t size);
+
+/**
+ * @brief Creates a game by loading it from a binary file.
+ * @details The binary format (.mosb), version 1, starts with a 16-byte header:
+ * the 4 characters "MOSB", the version, the wrapping (0 or 1), the
+ * neighbourhood, a zero byte, then the number of rows and the number of columns
+ * as 32-bit little-endian integers. The constraints of the squares follow in
+ * row-major order, 4 bits each (the constraint plus one, so 0 when
+ * unconstrained), low bits first, and then their colors, 2 bits each (EMPTY 0,
+ * WHITE 1, BLACK 2), low bits first. The file is mapped in memory and its
+ * squares are copied into the game as they are, with no parsing.
+ * @param filename input file
+ * @return the loaded game, or NULL if the file cannot be read or is not a
+ * valid binary game file; the reason is then printed on stderr
+ **/
+game game_load_binary(char* filename);
+
+/**
+ * @brief Saves a game in a binary file.
+ * @details See @ref game_load_binary for the format. The constraints above 14
+ * do not fit in 4 bits and are saved as 14: none of them can be satisfied.
+ * @param g game to save
+ * @param filename output file
+ **/
+void game_save_binary(cgame g, char* filename);
+
+/**
+ * @brief Creates a game from its binary format, in memory.
+ * @details Same as @ref game_load_binary on a file holding the @p size bytes of
+ * @p buffer.
+ * @param buffer the bytes of the game
+ * @param size number of bytes
+ * @return the loaded game, or NULL if the bytes are not a valid binary game;
+ * the reason is then printed on stderr
+ **/
+game game_load_binary_from_buffer(const char* buffer, size_t size);
+
+/**
+ * @brief Writes a game in the binary format, in memory.
+ * @details The bytes are those of @ref game_save_binary. They are written only
+ * if they fit in @p size bytes: the size needed is queried with a NULL
+ * @p buffer.
+ * @param g game to save
+ * @param buffer output buffer, or NULL
+ * @param size number of bytes of @p buffer
+ * @return the size of the binary game, written or not
+ **/
+size_t game_save_binary_to_buffer(cgame g, char* buffer, size_t size);
+
+/**
+ * @brief Computes the status of every square of a game.
+ * @param g the game
+ * @param map filled with the status of square (i,j) at i * width + j, as given
+ * by game_get_status
+ * @details The game keeps the counts of every neighbourhood up to date, so the
+ * map is a single pass over the grid.
+ **/
+void game_get_status_map(cgame g, status map[]);
+
 /**
  * @brief Computes the solution of a given game
  * @param g the game to solve
  * @details The game @p g is updated with the first solution found. If there are
- * no solution for this game, @p g must be unchanged.
+ * no solution for this game, @p g must be unchanged. Only the constraints of
+ * @p g are taken into account, the colors already played are ignored.
+ * This function, like all the solvers and counters below, exits with an error
+ * on a game of more than INT_MAX squares.
  * @return true if a solution is found, false otherwise
  */
 bool game_solve(game g);
 
+/** Order in which the search decides the squares. */
+typedef enum {
+  BRANCH_ROW_MAJOR,        /**< the first empty square in row-major order */
+  BRANCH_MOST_CONSTRAINED, /**< the square whose tightest constraint has the
+                              fewest ways left to place its black squares */
+  BRANCH_WDEG              /**< the square seen by the constraints that made
+                              the search fail most often (dom/wdeg) */
+} branching;
+
+/** Options of the search of @ref game_solve_ext. The budgets left to 0 do not
+ * limit the search. */
+typedef struct {
+  branching branching;         /**< branching heuristic */
+  double time_limit;           /**< wall-clock budget, in seconds */
+  unsigned long node_limit;    /**< maximum number of decisions */
+  const volatile bool* cancel; /**< if not NULL, the search stops as soon as
+                                  it sees *cancel true, which another thread
+                                  may set */
+} solve_opts;
+
+/**
+ * @brief Computes the solution of a given game with the given search options.
+ * @param g the game to solve
+ * @param opts the options of the search
+ * @details Same as @ref game_solve, which uses BRANCH_ROW_MAJOR without
+ * budgets. The solution found may depend on the options when there are
+ * several.
+ * @return true if a solution is found, false if there is none or if a budget
+ * ran out first
+ */
+bool game_solve_opts(game g, const solve_opts* opts);
+
+/** Outcomes of @ref game_solve_ext. */
+typedef enum {
+  SOLVED, /**< a solution was found */
+  UNSAT,  /**< the game has no solution */
+  TIMEOUT /**< a budget ran out, or the search was cancelled */
+} solve_status;
+
+/** What @ref game_solve_ext reports. */
+typedef struct {
+  solve_status status;
+  unsigned long nb_nodes; /**< number of decisions of the search */
+  double time;            /**< wall-clock time of the search, in seconds */
+} solve_result;
+
+/**
+ * @brief Computes the solution of a given game within budgets.
+ * @param g the game to solve
+ * @param opts the branching heuristic and the budgets of the search
+ * @param r if not NULL, filled with the outcome and the work done
+ * @details The budgets are checked before each decision of the search, the
+ * clock every 256 decisions. As for @ref game_solve, @p g gets the solution
+ * found, and is unchanged otherwise, including on TIMEOUT.
+ * @return SOLVED, UNSAT or TIMEOUT
+ */
+solve_status game_solve_ext(game g, const solve_opts* opts, solve_result* r);
+
+/**
+ * @brief Computes the solution of a given game with a SAT solver.
+ * @param g the game to solve
+ * @details Same as @ref game_solve, but the constraints are encoded as clauses
+ * (see @ref game_save_cnf) given to a conflict-driven clause learning solver,
+ * which copes better than the search of @ref game_solve with large games with
+ * few constraints.
+ * @return true if a solution is found, false otherwise
+ */
+bool game_solve_sat(game g);
+
+/**
+ * @brief Saves the constraints of a game as a SAT problem.
+ * @details The file is in the DIMACS CNF format. Variable i * width + j + 1 is
+ * true when square (i,j) is black, and each constraint is encoded as a
+ * sequential counter over the squares of its neighbourhood, which adds
+ * variables of its own.
+ * @param g game to encode
+ * @param filename output file
+ **/
+void game_save_cnf(cgame g, char* filename);
+
 /**
  * @brief Computes the total number of solutions of a given game.
  * @param g the game
- * @details The game @p g must be unchanged.
- * @return the number of solutions
+ * @details The undecided squares are split into independent components after
+ * each decision, and the count of each component is cached with the black
+ * squares still needed around it, so that a residual problem met again in
+ * another branch is not counted twice. The game @p g must be unchanged. As for
+ * @ref game_solve, only the constraints of @p g are taken into account.
+ * @return the number of solutions, or UINT_MAX if there are more
  */
 uint game_nb_solutions(cgame g);
 
+/**
+ * @brief Function called on each solution by @ref game_foreach_solution.
+ * @param colors the colors of the solution in row-major order, that is the
+ * color of square (i,j) is colors[i * nb_cols + j]; the buffer is only valid
+ * during the call
+ * @param ctx the context given to @ref game_foreach_solution
+ * @return true to go on with the next solution, false to stop
+ */
+typedef bool (*solution_callback)(const color colors[], void* ctx);
+
+/**
+ * @brief Calls a function on each solution of a given game.
+ * @param g the game
+ * @param callback the function called on each solution, in the order the
+ * search of @ref game_solve finds them
+ * @param ctx passed as is to @p callback
+ * @details The solutions are not stored: the memory used does not depend on
+ * their number. The game @p g must be unchanged, and as for @ref game_solve,
+ * only the constraints of @p g are taken into account.
+ * @return the number of solutions given to @p callback
+ */
+uint game_foreach_solution(cgame g, solution_callback callback, void* ctx);
+
+/**
+ * @brief Counts the solutions of a given game, up to a limit.
+ * @param g the game
+ * @param limit the number of solutions after which the search stops, 0 for no
+ * limit
+ * @details The game @p g must be unchanged. As for @ref game_solve, only the
+ * constraints of @p g are taken into account.
+ * @return the number of solutions if there are less than @p limit, @p limit
+ * otherwise
+ */
+uint game_nb_solutions_upto(cgame g, uint limit);
+
+/**
+ * @brief Checks whether a given game has exactly one solution.
+ * @param g the game
+ * @details Unlike @ref game_nb_solutions, the search stops as soon as a second
+ * solution is found. The game @p g must be unchanged, and as for
+ * @ref game_solve, only the constraints of @p g are taken into account.
+ * @return true if the game has a unique solution, false if it has none or
+ * several
+ */
+bool game_has_unique_solution(cgame g);
+
+/**
+ * @brief Computes the total number of solutions of a given game, with several
+ * threads.
+ * @param g the game
+ * @param nthreads the number of threads to use
+ * @details The search tree is split on the first undecided squares, and the
+ * threads count the subtrees as @ref game_nb_solutions does, stealing them
+ * from each other until they are all counted. The result is the same as
+ * @ref game_nb_solutions, which is used when @p nthreads is 0 or 1, including
+ * UINT_MAX for the counts that do not fit. The game @p g must be unchanged.
+ * @return the number of solutions
+ */
+uint game_nb_solutions_mt(cgame g, unsigned nthreads);
+
+/**
+ * @brief Computes the total number of solutions of a given game, square by
+ * square.
+ * @param g the game
+ * @details Each constraint only sees the squares around it, so the squares are
+ * colored one at a time along the longer side of the grid, keeping for each
+ * partly colored constraint only the number of black squares it still needs,
+ * and the number of ways to get there. The cost is exponential in the shorter
+ * side of the grid but linear in the longer one. Wrapping games keep the
+ * constraints of the first and last rows open all along, and are much slower to
+ * count. Like @ref game_nb_solutions, only the constraints are taken into
+ * account, and the game @p g must be unchanged.
+ * @return the number of solutions, or UINT_MAX if there are more
+ */
+uint game_nb_solutions_dp(cgame g);
+
 /**
  * @}
  */
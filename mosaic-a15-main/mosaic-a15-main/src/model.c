@@ -34,6 +34,9 @@
 #define SAVE "res/SAVE.png"
 #define WIN "res/WIN.png"
 
+// Seconds the SOLVE button may search before giving up.
+#define SOLVE_TIME_LIMIT 2.0
+
 // CELLS
 #define WHITE_CELL "res/CASE_BLANCHE_2.png"
 #define BLACK_CELL "res/CASE_NOIRE_2.png"
@@ -49,8 +52,6 @@
 #define NB_BUTTONS_LG 4
 #define NB_CELL_COLORS 3
 #define NB_BUTTONS_L 2
-// LOAD/SAVE
-#define LOAD_SAVE "load_save.txt"
 
 struct Env_t {
   SDL_Texture *background;
@@ -65,6 +66,9 @@ struct Env_t {
   // GAME
   game g;
   int game_nb_rows, game_nb_cols;
+  // Text of the game saved by the save button, or NULL
+  char *saved;
+  size_t saved_size;
 
   // Bottom buttons
   Button *buttons_LG[NB_BUTTONS_LG];
@@ -144,11 +148,14 @@ Env *init(SDL_Window *win, SDL_Renderer *ren, int argc, char *argv[]) {
   if (!env->background) ERROR("IMG_LoadTexture: %s\n", BACKGROUND);
 
   // INIT GAME
+  env->saved = NULL;
+  env->saved_size = 0;
   if (argc == 1) {
     env->g = game_default();  // No file given so init game_default
   }
   if (argc == 2) {
     env->g = game_load(argv[1]);
+    if (!env->g) exit(EXIT_FAILURE);
   }
 
   compute_dims(env, w, h);  // Init of the sizes value in the env struct with
@@ -194,6 +201,12 @@ void render(SDL_Window *win, SDL_Renderer *ren, Env *env) {
   int grid_y = (h / 2) - ((env->grid_height) / 2);
 
   // Drawing the cells
+  status *map = malloc(env->game_nb_rows * env->game_nb_cols * sizeof(status));
+  if (map == NULL) {
+    fprintf(stderr, "Memory allocation failed");
+    exit(EXIT_FAILURE);
+  }
+  game_get_status_map(env->g, map);
   for (int i = 0; i < env->game_nb_rows; i++) {
     for (int j = 0; j < env->game_nb_cols; j++) {
       color c = game_get_color(env->g, i, j);
@@ -213,11 +226,12 @@ void render(SDL_Window *win, SDL_Renderer *ren, Env *env) {
       destRect.y = rect.y + (env->cell_height - destRect.h) / 2;
       constraint con = game_get_constraint(env->g, i, j);
       if (con != -1)
-        SDL_RenderCopy(ren,
-                       env->digits_textures[game_get_status(env->g, i, j)][con],
-                       NULL, &destRect);
+        SDL_RenderCopy(
+            ren, env->digits_textures[map[i * env->game_nb_cols + j]][con],
+            NULL, &destRect);
     }
   }
+  free(map);
 
   // Drawing the Bottom placed buttons
   int ecart = env->button_width + (env->button_width / 3);
@@ -296,15 +310,35 @@ bool process(SDL_Window *win, SDL_Renderer *ren, Env *env, SDL_Event *e) {
           case 0:
             game_restart(env->g);
             break;
-          case 1:
-            game_solve(env->g);
+          case 1: {
+            // The window must not freeze on a game too hard to solve.
+            solve_opts opts = {BRANCH_ROW_MAJOR, SOLVE_TIME_LIMIT, 0, NULL};
+            if (game_solve_ext(env->g, &opts, NULL) == TIMEOUT)
+              fprintf(stderr, "No solution found in %g s\n", SOLVE_TIME_LIMIT);
             break;
+          }
           case 2:
-            game_load(LOAD_SAVE);
+            // The saved game replaces the current one.
+            if (env->saved) {
+              game g = game_load_from_buffer(env->saved, env->saved_size);
+              if (g) {
+                game_delete(env->g);
+                env->g = g;
+              }
+            }
             break;
-          case 3:
-            game_save(env->g, LOAD_SAVE);
+          case 3: {
+            // Kept in memory, as long as the window is open.
+            size_t size = game_save_to_buffer(env->g, NULL, 0);
+            char *saved = realloc(env->saved, size);
+            if (saved == NULL) {
+              fprintf(stderr, "Memory allocation failed");
+              exit(EXIT_FAILURE);
+            }
+            env->saved = saved;
+            env->saved_size = game_save_to_buffer(env->g, saved, size);
             break;
+          }
         }
       }
     }
@@ -340,6 +374,7 @@ void clean(SDL_Window *win, SDL_Renderer *ren, Env *env) {
     SDL_DestroyTexture(env->cell_colors[i]);
   }
   game_delete(env->g);
+  free(env->saved);
   free(env);
 
   /* **************************************************************** */